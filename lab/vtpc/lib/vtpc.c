@@ -5,6 +5,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+static struct vtpc_stats stats;
+
 int vtpc_open(const char* path, int mode, int access) {
   return open(path, mode, access);
 }
@@ -14,11 +16,23 @@ int vtpc_close(int fd) {
 }
 
 ssize_t vtpc_read(int fd, void* buf, size_t count) {
-  return read(fd, buf, count);
+  const ssize_t result = read(fd, buf, count);
+  stats.reads++;
+  if (result >= 0) {
+    // Nothing is cached yet, so every successful read went to the disk.
+    stats.misses++;
+    stats.bytes_read += (unsigned long long)result;
+  }
+  return result;
 }
 
 ssize_t vtpc_write(int fd, const void* buf, size_t count) {
-  return write(fd, buf, count);
+  const ssize_t result = write(fd, buf, count);
+  stats.writes++;
+  if (result > 0) {
+    stats.bytes_written += (unsigned long long)result;
+  }
+  return result;
 }
 
 off_t vtpc_lseek(int fd, off_t offset, int whence) {
@@ -28,3 +42,12 @@ off_t vtpc_lseek(int fd, off_t offset, int whence) {
 int vtpc_fsync(int fd) {
   return fsync(fd);
 }
+
+void vtpc_get_stats(struct vtpc_stats* out) {
+  *out = stats;
+}
+
+void vtpc_reset_stats(void) {
+  const struct vtpc_stats zero = {0};
+  stats = zero;
+}
@@ -2,9 +2,22 @@
 
 #include <sys/types.h>
 
+struct vtpc_stats {
+  unsigned long long reads;
+  unsigned long long writes;
+  unsigned long long hits;
+  unsigned long long misses;
+  unsigned long long evictions;
+  unsigned long long bytes_read;
+  unsigned long long bytes_written;
+};
+
 int vtpc_open(const char* path, int mode, int access);
 int vtpc_close(int fd);
 ssize_t vtpc_read(int fd, void* buf, size_t count);
 ssize_t vtpc_write(int fd, const void* buf, size_t count);
 off_t vtpc_lseek(int fd, off_t offset, int whence);
 int vtpc_fsync(int fd);
+// Counters are process-wide and cumulative until vtpc_reset_stats is called.
+void vtpc_get_stats(struct vtpc_stats* out);
+void vtpc_reset_stats(void);
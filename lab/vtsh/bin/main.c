@@ -1,27 +1,194 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "arena.h"
 #include "command.h"
+#include "linereader.h"
+#include "monitor.h"
+#include "profile.h"
 
-int main() {
-    char input[MAX_CMD_LENGTH];
-    while (1) {
-        printf("shell> "); 
-        if (fgets(input, sizeof(input), stdin) == NULL) {
-          printf("fgets returned NULL\n");
-          break;
+/* Script output is flushed only when full, at exit and before each fork. */
+#define SCRIPT_OUTPUT_BUFFER (64 * 1024)
+/* Exit status for usage and syntax errors, as in sh. */
+#define STATUS_USAGE 2
+
+static void usage(void) {
+    fprintf(stderr, "Usage: vtsh [-i] [-p] [-t] [-m file [-M ms]] [-s backend] [-c command | script]\n"
+                    "  -c  run the given command lines and exit\n"
+                    "  -i  interactive: prompt and timing even when stdin is not a terminal\n"
+                    "  -m  record a CPU, disk and pressure timeline of every command (CSV, or JSON for *.json)\n"
+                    "  -M  sampling interval for -m in milliseconds, 100 by default\n"
+                    "  -p  profile: CPU time, context switches, faults, RSS and perf counters per command\n"
+                    "  -s  start commands with fork (default), vfork, clone3 or posix_spawn\n"
+                    "  -t  print the execution time of every command in script mode\n");
+}
+
+static int run_line(char* line, Arena* arena) {
+    AstNode* tree;
+    int status = 0;
+    if (parse_line(line, arena, &tree) != 0) {
+        status = STATUS_USAGE;
+    } else if (tree) {
+        status = execute_tree(tree);
+    }
+    arena_reset(arena);
+    return status;
+}
+
+/* A forked shell (a background job, a bench copy) must not add rows to the parent's timeline. */
+static void forget_monitor(void) {
+    shell_config.monitor = NULL;
+}
+
+static void sync_stdin(void* arg) {
+    line_reader_sync(arg);
+}
+
+/* -c text may hold several lines; each is parsed and run in turn. */
+static int run_string(char* text, Arena* arena) {
+    int status = 0;
+    for (char* line = text; line; ) {
+        char* newline = strchr(line, '\n');
+        if (newline) {
+            *newline = '\0';
         }
-        
-        if (strlen(input) <= 1) {
-          continue;
+        reap_background_jobs();
+        status = run_line(line, arena);
+        line = newline ? newline + 1 : NULL;
+    }
+    return status;
+}
+
+static int run_reader(LineReader* reader, Arena* arena, bool interactive) {
+    int status = 0;
+    for (;;) {
+        reap_background_jobs();
+        if (interactive) {
+            printf("shell> ");
+            fflush(stdout);
+        }
+        char* line = line_reader_next(reader);
+        if (!line) {
+            if (interactive) {
+                printf("fgets returned NULL\n");
+            }
+            break;
         }
+        status = run_line(line, arena);
+    }
+    return status;
+}
 
-        Command* cmd = create_command(input);
-        if (cmd) {
-            execute_command(cmd);
-            free_command(cmd);
+int main(int argc, char** argv) {
+    char* command = NULL;
+    bool force_interactive = false;
+    bool timing = false;
+    const char* monitor_path = NULL;
+    unsigned long interval_ms = MONITOR_DEFAULT_INTERVAL_MS;
+    char* endptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "+c:im:M:ps:t")) != -1) {
+        switch (opt) {
+        case 'c':
+            command = optarg;
+            break;
+        case 'i':
+            force_interactive = true;
+            break;
+        case 'm':
+            monitor_path = optarg;
+            break;
+        case 'M':
+            interval_ms = strtoul(optarg, &endptr, 10);
+            if (*endptr != '\0' || interval_ms == 0 || interval_ms > 3600000) {
+                usage();
+                return STATUS_USAGE;
+            }
+            break;
+        case 'p':
+            shell_config.profile = true;
+            break;
+        case 's':
+            if (spawn_backend_parse(optarg, &shell_config.spawn_backend) != 0) {
+                usage();
+                return STATUS_USAGE;
+            }
+            break;
+        case 't':
+            timing = true;
+            break;
+        default:
+            usage();
+            return STATUS_USAGE;
         }
     }
+    const char* script = optind < argc ? argv[optind] : NULL;
+    if ((command && script) || optind + 1 < argc) {
+        usage();
+        return STATUS_USAGE;
+    }
 
-    return 0;
-}
\ No newline at end of file
+    bool interactive = force_interactive || (!command && !script && isatty(STDIN_FILENO));
+    shell_config.print_timing = interactive || timing;
+    shell_config.report_jobs = interactive;
+    if (!interactive) {
+        setvbuf(stdout, NULL, _IOFBF, SCRIPT_OUTPUT_BUFFER);
+    }
+    /* Counters are inherited only by threads and children started after this. */
+    if (shell_config.profile && profile_open_counters() != 0) {
+        fprintf(stderr, "vtsh: perf counters are not available, profiling with rusage only\n");
+    }
+
+    Monitor monitor;
+    if (monitor_path) {
+        if (monitor_open(&monitor, monitor_path, (unsigned)interval_ms) != 0) {
+            perror(monitor_path);
+            return 1;
+        }
+        shell_config.monitor = &monitor;
+        pthread_atfork(NULL, NULL, forget_monitor);
+    }
+
+    Arena arena;
+    arena_init(&arena);
+    /* -c and scripts exit with the last command's status, as in sh; stdin still ends with 0. */
+    int status = 0;
+    if (command) {
+        status = run_string(command, &arena);
+    } else {
+        int fd = script ? open(script, O_RDONLY | O_CLOEXEC) : STDIN_FILENO;
+        LineReader reader;
+        if (fd < 0) {
+            perror(script);
+            return 127;
+        }
+        if (line_reader_open(&reader, fd) != 0) {
+            fprintf(stderr, "vtsh: memory allocation failed\n");
+            return 1;
+        }
+        /* Commands share our stdin, so they must not lose input the shell has only read ahead. */
+        if (!script) {
+            shell_config.before_fork = sync_stdin;
+            shell_config.before_fork_arg = &reader;
+        }
+        int last = run_reader(&reader, &arena, interactive);
+        if (script) {
+            status = last;
+        }
+        line_reader_close(&reader);
+        if (script) {
+            close(fd);
+        }
+    }
+
+    arena_free(&arena);
+    profile_close_counters();
+    if (monitor_path) {
+        monitor_close(&monitor);
+    }
+    return status;
+}
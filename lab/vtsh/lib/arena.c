@@ -0,0 +1,75 @@
+#include <stdalign.h>
+#include <stdlib.h>
+#include "arena.h"
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+/* Block payload starts after the header, rounded up so it is aligned too. */
+#define ARENA_HEADER_SIZE ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+static char* block_data(ArenaBlock* block) {
+    return (char*)block + ARENA_HEADER_SIZE;
+}
+
+void arena_init(Arena* arena) {
+    arena->head = NULL;
+    arena->current = NULL;
+}
+
+/*
+ * Blocks after current are left over from before the last reset; they are
+ * reused when big enough, otherwise a new block is linked in after current.
+ */
+static ArenaBlock* next_block(Arena* arena, size_t size) {
+    ArenaBlock* next = arena->current ? arena->current->next : arena->head;
+    if (next && next->size >= size) {
+        next->used = 0;
+        return next;
+    }
+
+    size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    ArenaBlock* block = malloc(ARENA_HEADER_SIZE + capacity);
+    if (!block) {
+        return NULL;
+    }
+    block->size = capacity;
+    block->used = 0;
+    block->next = next;
+    if (arena->current) {
+        arena->current->next = block;
+    } else {
+        arena->head = block;
+    }
+    return block;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    ArenaBlock* block = arena->current;
+    if (!block || block->size - block->used < size) {
+        block = next_block(arena, size);
+        if (!block) {
+            return NULL;
+        }
+        arena->current = block;
+    }
+    void* memory = block_data(block) + block->used;
+    block->used += size;
+    return memory;
+}
+
+void arena_reset(Arena* arena) {
+    arena->current = arena->head;
+    if (arena->head) {
+        arena->head->used = 0;
+    }
+}
+
+void arena_free(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
@@ -0,0 +1,34 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (16 * 1024)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+/*
+ * Bump allocator for data that dies all at once, such as the AST of one
+ * command line. Blocks are kept across resets, so after warming up a
+ * line costs no malloc at all.
+ */
+typedef struct {
+    ArenaBlock* head;
+    ArenaBlock* current;
+} Arena;
+
+void arena_init(Arena* arena);
+
+/* Returns max_align_t aligned memory, or NULL when a new block cannot be allocated. */
+void* arena_alloc(Arena* arena, size_t size);
+
+/* Forgets every allocation in O(1); the blocks are reused by later allocations. */
+void arena_reset(Arena* arena);
+
+void arena_free(Arena* arena);
+
+#endif
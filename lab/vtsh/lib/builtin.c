@@ -5,22 +5,105 @@
 #include <time.h>
 #include <openssl/md5.h>
 #include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include "command.h"
+#include "extsort.h"
+#include "factor.h"
+#include "graph.h"
+#include "join.h"
+#include "matmul.h"
+#include "md5x.h"
+#include "pathcache.h"
+#include "pool.h"
+#include "process.h"
+
+#ifdef VTSH_EMA_VTPC
+#include "vtpc.h"
+#endif
+
+/* Larger products are summarized by a checksum instead of O(n^2) output. */
+#define MAT_MUL_PRINT_LIMIT 16
+/* Numbers read with -f are factored and printed in batches of this size. */
+#define FACTORIZE_BATCH 16384
+/* spawn-bench defaults: 10k runs of /bin/true after a short warm-up. */
+#define SPAWN_BENCH_RUNS 10000
+#define SPAWN_BENCH_WARMUP 100
+/* bench defaults and the most copies -j may start at once. */
+#define BENCH_RUNS 10
+#define BENCH_WARMUP 1
+#define BENCH_MAX_JOBS 1024
+/* Quartiles of fewer runs say nothing about outliers. */
+#define BENCH_MIN_OUTLIER_RUNS 5
+
+/*
+ * Removes a "-j N" (or "-jN") option from args in place so the remaining
+ * arguments keep their positions. jobs is left untouched when it is absent.
+ */
+static int take_jobs_option(char** args, int* jobs) {
+    for (int i = 1; args[i]; i++) {
+        if (strncmp(args[i], "-j", 2) != 0) {
+            continue;
+        }
+        const char* value = args[i][2] ? args[i] + 2 : args[i + 1];
+        int consumed = args[i][2] ? 1 : 2;
+        char* endptr;
+        long parsed = value ? strtol(value, &endptr, 10) : 0;
+        if (!value || *endptr != '\0' || parsed < 1 || parsed > POOL_MAX_THREADS) {
+            fprintf(stderr, "%s: invalid job count '%s'\n", args[0], value ? value : "");
+            return -1;
+        }
+        *jobs = (int)parsed;
+        for (int j = i; ; j++) {
+            args[j] = args[j + consumed];
+            if (!args[j]) {
+                break;
+            }
+        }
+        return 0;
+    }
+    return 0;
+}
 
 
 void execute_exit(char** args) {
     printf("Goodbye!\n");
+    /* exit runs as a monitored command itself; its end row and the closing of a JSON timeline would be lost. */
+    if (shell_config.monitor) {
+        monitor_end(shell_config.monitor);
+        monitor_close(shell_config.monitor);
+    }
+    /* _exit skips stdio, and in script mode stdout is fully buffered. */
+    fflush(NULL);
     _exit(0);
 }
 
 
+static void print_matrix(const char* title, const int* M, int n) {
+    int i, j;
+    printf("%s\n", title);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            printf("%3d ", M[(size_t)i * n + j]);
+        }
+        printf("\n");
+    }
+}
+
 void execute_mat_mul(char** args) {
     int n;
-    int i, j, k;
+    size_t i, cells;
     int *A, *B, *C;
 
+    int jobs = 1;
+    if (take_jobs_option(args, &jobs) != 0) {
+        return;
+    }
     if (!args[1]) {
-        printf("Usage: mat-mul <size>\n");
+        printf("Usage: mat-mul [-j N] <size> [auto|scalar|avx2|avx512]\n");
         return;
     }
 
@@ -30,11 +113,31 @@ void execute_mat_mul(char** args) {
         return;
     }
 
+    MatmulKernel requested = MATMUL_AUTO;
+    if (args[2]) {
+        if (strcmp(args[2], "scalar") == 0) {
+            requested = MATMUL_SCALAR;
+        } else if (strcmp(args[2], "avx2") == 0) {
+            requested = MATMUL_AVX2;
+        } else if (strcmp(args[2], "avx512") == 0) {
+            requested = MATMUL_AVX512;
+        } else if (strcmp(args[2], "auto") != 0) {
+            printf("Unknown kernel '%s', expected auto, scalar, avx2 or avx512\n", args[2]);
+            return;
+        }
+    }
+    MatmulKernel kernel;
+    if (matmul_select_kernel(requested, &kernel) != 0) {
+        printf("Kernel '%s' is not supported by this CPU\n", args[2]);
+        return;
+    }
+
     srand((unsigned)time(NULL));
 
-    A = malloc(n * n * sizeof(int));
-    B = malloc(n * n * sizeof(int));
-    C = malloc(n * n * sizeof(int));
+    cells = (size_t)n * n;
+    A = malloc(cells * sizeof(int));
+    B = malloc(cells * sizeof(int));
+    C = malloc(cells * sizeof(int));
 
     if (!A || !B || !C) {
         printf("Memory allocation failed\n");
@@ -44,65 +147,162 @@ void execute_mat_mul(char** args) {
         return;
     }
 
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            A[i * n + j] = rand() % 10;
-            B[i * n + j] = rand() % 10;
-            C[i * n + j] = 0;
-        }
+    for (i = 0; i < cells; i++) {
+        A[i] = rand() % 10;
+        B[i] = rand() % 10;
     }
 
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            for (k = 0; k < n; k++) {
-                C[i * n + j] += A[i * n + k] * B[k * n + j];
-            }
+    if (matmul_int(A, B, C, (size_t)n, kernel, jobs) != 0) {
+        printf("Memory allocation failed\n");
+    } else if (n <= MAT_MUL_PRINT_LIMIT) {
+        print_matrix("Matrix A:", A, n);
+        print_matrix("Matrix B:", B, n);
+        print_matrix("Matrix C = A * B:", C, n);
+    } else {
+        /* Printing is O(n^2) output; a position-weighted sum still catches wrong cells. */
+        unsigned long long checksum = 0;
+        for (i = 0; i < cells; i++) {
+            checksum = checksum * 31 + (unsigned int)C[i];
         }
+        printf("Matrix C = A * B: %dx%d, %s kernel, checksum %016llx\n", n, n, matmul_kernel_name(kernel), checksum);
     }
 
-    printf("Matrix A:\n");
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            printf("%3d ", A[i * n + j]);
-        }
-        printf("\n");
-    }
+    free(A);
+    free(B);
+    free(C);
+}
 
-    printf("Matrix B:\n");
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            printf("%3d ", B[i * n + j]);
+
+static const char* md5_fragments[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet",
+    "consectetur", "adipiscing", "elit",
+    "sed", "do", "eiusmod", "tempor", "incididunt"
+};
+#define MD5_FRAGMENTS_COUNT (sizeof(md5_fragments) / sizeof(md5_fragments[0]))
+#define MD5_CHUNK_SIZE (16 * 1024)
+
+/*
+ * Generates the text of one message on demand: `remaining` fragments drawn
+ * with rand_r from the message's own seed, separated by single spaces.
+ * Replaying a stream from the same seed yields the same text.
+ */
+typedef struct {
+    unsigned seed;
+    int remaining;
+    const char* pending;
+    size_t pending_length;
+    int separator;
+} TextStream;
+
+static void text_stream_init(TextStream* stream, unsigned seed, int count) {
+    stream->seed = seed;
+    stream->remaining = count;
+    stream->pending = NULL;
+    stream->pending_length = 0;
+    stream->separator = 0;
+}
+
+static size_t text_stream_read(void* arg, unsigned char* dst, size_t capacity) {
+    TextStream* stream = arg;
+    size_t length = 0;
+    while (length < capacity) {
+        if (stream->pending_length == 0) {
+            if (stream->separator) {
+                dst[length++] = ' ';
+                stream->separator = 0;
+                continue;
+            }
+            if (stream->remaining == 0) {
+                break;
+            }
+            stream->pending = md5_fragments[rand_r(&stream->seed) % MD5_FRAGMENTS_COUNT];
+            stream->pending_length = strlen(stream->pending);
+            stream->separator = --stream->remaining > 0;
         }
-        printf("\n");
+        size_t n = capacity - length < stream->pending_length ? capacity - length : stream->pending_length;
+        memcpy(dst + length, stream->pending, n);
+        length += n;
+        stream->pending += n;
+        stream->pending_length -= n;
     }
+    return length;
+}
 
-    printf("Matrix C = A * B:\n");
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            printf("%3d ", C[i * n + j]);
-        }
-        printf("\n");
+typedef struct {
+    int count;
+    unsigned seed;
+    int lanes;
+    size_t messages;
+    unsigned char (*digests)[MD5_DIGEST_LENGTH];
+} Md5Job;
+
+/* Streams one message through MD5_Update in fixed chunks. */
+static void calc_md5_message(void* arg, size_t index) {
+    Md5Job* job = arg;
+    TextStream stream;
+    unsigned char chunk[MD5_CHUNK_SIZE];
+    size_t length;
+    MD5_CTX context;
+
+    text_stream_init(&stream, job->seed + (unsigned)index, job->count);
+    MD5_Init(&context);
+    while ((length = text_stream_read(&stream, chunk, sizeof(chunk))) > 0) {
+        MD5_Update(&context, chunk, length);
     }
+    MD5_Final(job->digests[index], &context);
+}
 
-    free(A);
-    free(B);
-    free(C);
+/* Hashes messages [index * lanes, index * lanes + lanes) side by side in SIMD lanes. */
+static void calc_md5_lanes(void* arg, size_t index) {
+    Md5Job* job = arg;
+    TextStream streams[MD5X_MAX_LANES];
+    void* pointers[MD5X_MAX_LANES];
+    size_t first = index * (size_t)job->lanes;
+    size_t count = job->messages - first < (size_t)job->lanes ? job->messages - first : (size_t)job->lanes;
+
+    for (size_t l = 0; l < count; l++) {
+        text_stream_init(&streams[l], job->seed + (unsigned)(first + l), job->count);
+        pointers[l] = &streams[l];
+    }
+    md5x_digest(pointers, count, text_stream_read, job->lanes, job->digests + first);
 }
 
+static void echo_message(const Md5Job* job, size_t index) {
+    TextStream stream;
+    unsigned char chunk[MD5_CHUNK_SIZE];
+    size_t length;
+
+    text_stream_init(&stream, job->seed + (unsigned)index, job->count);
+    printf("Generated text: ");
+    while ((length = text_stream_read(&stream, chunk, sizeof(chunk))) > 0) {
+        fwrite(chunk, 1, length, stdout);
+    }
+    printf("\n");
+}
 
 void execute_calc_md5(char** args) {
     int n, i;
-    const char* fragments[] = {
-        "lorem", "ipsum", "dolor", "sit", "amet",
-        "consectetur", "adipiscing", "elit",
-        "sed", "do", "eiusmod", "tempor", "incididunt"
-    };
-    int fragments_count = sizeof(fragments) / sizeof(fragments[0]);
-    char buffer[4096];
-    unsigned char digest[MD5_DIGEST_LENGTH];
+    size_t m, messages = 1;
+    int jobs = 1;
+    int echo = 1;
+    int requested_lanes = 0;
 
+    if (take_jobs_option(args, &jobs) != 0) {
+        return;
+    }
+    while (args[1] && args[1][0] == '-') {
+        if (strcmp(args[1], "-q") == 0) {
+            echo = 0;
+            args++;
+        } else if (strcmp(args[1], "-l") == 0 && args[2]) {
+            requested_lanes = atoi(args[2]);
+            args += 2;
+        } else {
+            break;
+        }
+    }
     if (!args[1]) {
-        printf("Usage: calc-md5 <count>\n");
+        printf("Usage: calc-md5 [-j N] [-q] [-l 1|4|8|16] <count> [messages]\n");
         return;
     }
 
@@ -111,174 +311,927 @@ void execute_calc_md5(char** args) {
         printf("Count must be positive\n");
         return;
     }
+    if (args[2]) {
+        int parsed = atoi(args[2]);
+        if (parsed <= 0) {
+            printf("Messages must be positive\n");
+            return;
+        }
+        messages = (size_t)parsed;
+    }
 
-    srand((unsigned)time(NULL));
-    buffer[0] = '\0';
+    Md5Job job = {n, (unsigned)time(NULL), 1, messages, malloc(messages * MD5_DIGEST_LENGTH)};
+    if (requested_lanes != 1 && messages > 1 && md5x_select_lanes(requested_lanes, &job.lanes) != 0) {
+        printf("Lane count %d is not supported, expected 1, 4, 8 or 16 within this CPU's SIMD width\n",
+               requested_lanes);
+        free(job.digests);
+        return;
+    }
+    if (!job.digests) {
+        printf("Memory allocation failed\n");
+        return;
+    }
 
-    for (i = 0; i < n; i++) {
-        const char* frag = fragments[rand() % fragments_count];
-        strcat(buffer, frag);
-        if (i != n - 1) strcat(buffer, " ");
+    if (job.lanes > 1) {
+        size_t groups = (messages + (size_t)job.lanes - 1) / (size_t)job.lanes;
+        pool_parallel_for(groups, jobs, calc_md5_lanes, &job);
+    } else {
+        pool_parallel_for(messages, jobs, calc_md5_message, &job);
+    }
+
+    for (m = 0; m < messages; m++) {
+        if (echo) {
+            echo_message(&job, m);
+        }
+        printf("MD5 hash: ");
+        for (i = 0; i < MD5_DIGEST_LENGTH; i++) {
+            printf("%02x", job.digests[m][i]);
+        }
+        printf("\n");
     }
 
-    MD5((unsigned char*)buffer, strlen(buffer), digest);
+    free(job.digests);
+}
 
-    printf("Generated text: %s\n", buffer);
-    printf("MD5 hash: ");
-    for (i = 0; i < MD5_DIGEST_LENGTH; i++) {
-        printf("%02x", digest[i]);
+/* strtoull quietly accepts signs and wraps negatives, so only plain digits pass. */
+static int parse_u64(const char* text, uint64_t* number) {
+    char* endptr;
+    if (!isdigit((unsigned char)text[0])) {
+        return -1;
     }
-    printf("\n");
+    errno = 0;
+    unsigned long long value = strtoull(text, &endptr, 10);
+    if (*endptr != '\0' || errno == ERANGE) {
+        return -1;
+    }
+    *number = (uint64_t)value;
+    return 0;
 }
 
-typedef struct {
-    int id;
-    char word[9];
-} Row;
+/* Accepts a plain byte count or one with a K, M or G suffix. */
+static int parse_memory_size(const char* text, size_t* size) {
+    char* endptr;
+    errno = 0;
+    unsigned long long value = strtoull(text, &endptr, 10);
+    if (errno == ERANGE || endptr == text) {
+        return -1;
+    }
 
-void execute_ema_join_inner(char** args) {
-    int i, j;
+    const char* suffixes = "KMG";
+    const char* suffix = *endptr ? strchr(suffixes, toupper((unsigned char)*endptr)) : NULL;
+    if (suffix) {
+        value <<= 10 * (suffix - suffixes + 1);
+        endptr++;
+    }
+    if (*endptr != '\0' || value == 0) {
+        return -1;
+    }
+    *size = (size_t)value;
+    return 0;
+}
 
+void execute_ema_join_inner(char** args) {
+    /* radix is parallel by design and uses the whole pool unless told otherwise. */
+    int jobs = 0;
+    if (take_jobs_option(args, &jobs) != 0) {
+        return;
+    }
     if (!args[1] || !args[2] || !args[3]) {
-        fprintf(stderr, "Usage: ema-join-inner <file1> <file2> <output_file>\n");
+        fprintf(stderr, "Usage: ema-join-inner [-j N] <file1> <file2> <output_file> [nl|hash|sm [memory_limit]|radix]\n");
+        return;
+    }
+
+    const char* strategy = args[4] ? args[4] : "hash";
+    if (strcmp(strategy, "nl") != 0 && strcmp(strategy, "hash") != 0 && strcmp(strategy, "sm") != 0 &&
+        strcmp(strategy, "radix") != 0) {
+        fprintf(stderr, "ema-join-inner: unknown strategy '%s', expected nl, hash, sm or radix\n", strategy);
         return;
     }
 
+    size_t memory_limit = JOIN_DEFAULT_MEMORY_LIMIT;
+    if (strcmp(strategy, "sm") == 0 && args[5] && parse_memory_size(args[5], &memory_limit) != 0) {
+        fprintf(stderr, "ema-join-inner: invalid memory limit '%s'\n", args[5]);
+        return;
+    }
+
+    if (jobs == 0) {
+        jobs = strcmp(strategy, "radix") == 0 ? pool_default_threads() : 1;
+    }
+
     FILE *file1 = fopen(args[1], "r");
     FILE *file2 = fopen(args[2], "r");
     FILE *output = fopen(args[3], "w");
-    
+    Table table1 = {NULL, 0};
+    Table table2 = {NULL, 0};
+    JoinMergeStats merge_stats;
+    int status = -1;
+
     if (!file1 || !file2 || !output) {
         fprintf(stderr, "Error opening files\n");
-        if (file1) fclose(file1);
-        if (file2) fclose(file2);
-        if (output) fclose(output);
+    } else if (strcmp(strategy, "sm") == 0) {
+        status = join_sort_merge(file1, file2, output, memory_limit, &merge_stats);
+    } else if (table_load(file1, "table1", &table1) == 0 && table_load(file2, "table2", &table2) == 0) {
+        if (strcmp(strategy, "nl") == 0) {
+            status = join_nested_loop(&table1, &table2, output, jobs);
+        } else if (strcmp(strategy, "radix") == 0) {
+            status = join_radix(&table1, &table2, output, jobs);
+        } else {
+            status = join_hash(&table1, &table2, output, jobs);
+        }
+    }
+
+    free(table1.rows);
+    free(table2.rows);
+    if (file1) fclose(file1);
+    if (file2) fclose(file2);
+    if (output) fclose(output);
+    if (status == 0 && strcmp(strategy, "sm") == 0) {
+        printf("sm: %zu runs, %zu merge passes, %zu-row merge buffers, %zu bytes mapped outside the limit\n",
+               merge_stats.runs, merge_stats.merge_passes, merge_stats.buffer_rows, merge_stats.mapped_bytes);
+    }
+    if (status == 0) {
+        printf("Operation completed successfully\n");
+    }
+}
+
+
+void execute_ema_table_convert(char** args) {
+    if (!args[1] || !args[2]) {
+        fprintf(stderr, "Usage: ema-table-convert <input_file> <output_file> [bin|sorted|text]\n");
         return;
     }
 
-    int n1;
-    if (fscanf(file1, "%d", &n1) != 1) {
-        fprintf(stderr, "Error reading table1 size\n");
-        fclose(file1);
-        fclose(file2);
-        fclose(output);
+    const char* format = args[3] ? args[3] : "bin";
+    if (strcmp(format, "bin") != 0 && strcmp(format, "sorted") != 0 && strcmp(format, "text") != 0) {
+        fprintf(stderr, "ema-table-convert: unknown format '%s', expected bin, sorted or text\n", format);
         return;
     }
 
-    Row* table1 = malloc(n1 * sizeof(Row));
-    for (i = 0; i < n1; i++) {
-        char temp_word[100];
-        if (fscanf(file1, "%d %99s", &table1[i].id, temp_word) != 2) {
-            free(table1);
-            fclose(file1);
-            fclose(file2);
-            fclose(output);
-            return;
+    FILE *input = fopen(args[1], "r");
+    if (!input) {
+        fprintf(stderr, "Error opening files\n");
+        return;
+    }
+    Table table = {NULL, 0};
+    int status = table_load(input, "table", &table);
+    fclose(input);
+
+    FILE *output = NULL;
+    if (status == 0) {
+        output = fopen(args[2], "w");
+        if (!output) {
+            fprintf(stderr, "Error opening files\n");
+            status = -1;
         }
-        if (strlen(temp_word) != 8) {
-            fprintf(stderr, "Invalid word length in table1 at row %d: expected 8, got %zu\n", i, strlen(temp_word));
-            free(table1);
-            fclose(file1);
-            fclose(file2);
-            fclose(output);
-            return;
+    }
+    if (status == 0) {
+        if (strcmp(format, "text") == 0) {
+            status = table_write_text(&table, output);
+        } else {
+            status = table_write_binary(&table, output, strcmp(format, "sorted") == 0);
+        }
+        if (fclose(output) != 0 || status != 0) {
+            perror("ema-table-convert: writing output");
+            status = -1;
+        }
+    }
+
+    free(table.rows);
+    if (status == 0) {
+        printf("Converted %d rows\n", table.count);
+    }
+}
+
+
+/* Parses the value of an "-e posix|vtpc" option and checks that the engine was built in. */
+static int parse_engine(const char* command, const char* value, IoEngine* engine) {
+    if (value && strcmp(value, "posix") == 0) {
+        *engine = IO_ENGINE_POSIX;
+    } else if (value && strcmp(value, "vtpc") == 0) {
+        *engine = IO_ENGINE_VTPC;
+    } else {
+        fprintf(stderr, "%s: unknown engine '%s', expected posix or vtpc\n", command, value ? value : "");
+        return -1;
+    }
+    if (io_engine_available(*engine) != 0) {
+        fprintf(stderr, "%s: built without vtpc, reconfigure with -DVTSH_EMA_VTPC=ON\n", command);
+        return -1;
+    }
+    return 0;
+}
+
+/* vtpc counts for the whole process, so every command that reports them starts from zero. */
+static void reset_engine_stats(void) {
+#ifdef VTSH_EMA_VTPC
+    vtpc_reset_stats();
+#endif
+}
+
+static void print_engine_stats(IoEngine engine) {
+#ifdef VTSH_EMA_VTPC
+    if (engine == IO_ENGINE_VTPC) {
+        struct vtpc_stats stats;
+        vtpc_get_stats(&stats);
+        printf("vtpc: %llu reads, %llu writes, %llu hits, %llu misses, %llu evictions\n", stats.reads, stats.writes,
+               stats.hits, stats.misses, stats.evictions);
+    }
+#else
+    (void)engine;
+#endif
+}
+
+#define SORT_MAX_POSITIONAL 3
+
+static const char* sort_usage =
+    "Usage: ema-sort-int gen <file> <count> [seed] [options]\n"
+    "       ema-sort-int sort <input> <output> [options]\n"
+    "       ema-sort-int verify <file> [options]\n"
+    "Options: -m <memory_limit> -b <buffer_size> -d (double buffering) -e posix|vtpc\n";
+
+/* Splits args after the subcommand into positionals and -m/-b/-d/-e options. */
+static int parse_sort_args(char** args, const char** positional, int* positional_count, SortOptions* options) {
+    *positional_count = 0;
+    for (int i = 2; args[i]; i++) {
+        const char* value = args[i + 1];
+        if (strcmp(args[i], "-d") == 0) {
+            options->double_buffer = true;
+        } else if (strcmp(args[i], "-m") == 0 || strcmp(args[i], "-b") == 0) {
+            size_t* size = args[i][1] == 'm' ? &options->memory_limit : &options->buffer_size;
+            if (!value || parse_memory_size(value, size) != 0) {
+                fprintf(stderr, "ema-sort-int: invalid size for %s\n", args[i]);
+                return -1;
+            }
+            i++;
+        } else if (strcmp(args[i], "-e") == 0) {
+            if (parse_engine(args[0], value, &options->engine) != 0) {
+                return -1;
+            }
+            i++;
+        } else if (args[i][0] == '-' || *positional_count == SORT_MAX_POSITIONAL) {
+            fprintf(stderr, "ema-sort-int: unexpected argument '%s'\n", args[i]);
+            return -1;
+        } else {
+            positional[(*positional_count)++] = args[i];
         }
-        strcpy(table1[i].word, temp_word);
     }
+    return 0;
+}
 
-    int n2;
-    if (fscanf(file2, "%d", &n2) != 1) {
-        fprintf(stderr, "Error reading table2 size\n");
-        free(table1);
-        fclose(file1);
-        fclose(file2);
-        fclose(output);
+void execute_ema_sort_int(char** args) {
+    SortOptions options = {SORT_DEFAULT_MEMORY_LIMIT, SORT_DEFAULT_BUFFER_SIZE, false, IO_ENGINE_POSIX};
+    const char* positional[SORT_MAX_POSITIONAL];
+    int count = 0;
+    const char* mode = args[1];
+    reset_engine_stats();
+    if (!mode || parse_sort_args(args, positional, &count, &options) != 0) {
+        fprintf(stderr, "%s", sort_usage);
         return;
     }
 
-    Row* table2 = malloc(n2 * sizeof(Row));
-    for (i = 0; i < n2; i++) {
-        char temp_word[100];
-        if (fscanf(file2, "%d %99s", &table2[i].id, temp_word) != 2) {
-            free(table1);
-            free(table2);
-            fclose(file1);
-            fclose(file2);
-            fclose(output);
+    SortStats stats;
+    if (strcmp(mode, "gen") == 0 && (count == 2 || count == 3)) {
+        uint64_t values, seed = (uint64_t)time(NULL);
+        if (parse_u64(positional[1], &values) != 0 || (count == 3 && parse_u64(positional[2], &seed) != 0)) {
+            fprintf(stderr, "ema-sort-int: invalid count or seed\n");
             return;
         }
-        if (strlen(temp_word) != 8) {
-            fprintf(stderr, "Invalid word length in table2 at row %d: expected 8, got %zu\n", i, strlen(temp_word));
-            free(table1);
-            free(table2);
-            fclose(file1);
-            fclose(file2);
-            fclose(output);
+        if (sort_generate(positional[0], values, seed, &options) == 0) {
+            printf("Generated %llu values into %s\n", (unsigned long long)values, positional[0]);
+        }
+    } else if (strcmp(mode, "sort") == 0 && count == 2) {
+        if (sort_file(positional[0], positional[1], &options, &stats) != 0) {
             return;
         }
-        strcpy(table2[i].word, temp_word);
+        printf("Sorted %llu values: %zu runs, %zu merge passes, fan-in %zu\n", (unsigned long long)stats.count,
+               stats.runs, stats.passes, stats.fan_in);
+
+        /* The checksum ignores order, so together with the count it catches lost or duplicated values. */
+        SortStats check;
+        bool sorted;
+        if (sort_verify(positional[1], &options, &check, &sorted) != 0) {
+            return;
+        }
+        if (!sorted || check.count != stats.count || check.checksum != stats.checksum) {
+            fprintf(stderr, "ema-sort-int: verification failed: %s\n",
+                    !sorted ? "output is out of order" : "output is not a permutation of the input");
+        } else {
+            printf("Verified: output is sorted and a permutation of the input\n");
+        }
+    } else if (strcmp(mode, "verify") == 0 && count == 1) {
+        bool sorted;
+        if (sort_verify(positional[0], &options, &stats, &sorted) == 0) {
+            printf("%s: %llu values, %s\n", positional[0], (unsigned long long)stats.count,
+                   sorted ? "sorted" : "NOT sorted");
+        }
+    } else {
+        fprintf(stderr, "%s", sort_usage);
+        return;
     }
+    print_engine_stats(options.engine);
+}
 
-    int count = 0;
-    for (i = 0; i < n1; i++) {
-        for (j = 0; j < n2; j++) {
-            if (table1[i].id == table2[j].id) {
-                count++;
+
+static int parse_i32(const char* text, int32_t* number) {
+    char* endptr;
+    errno = 0;
+    long value = strtol(text, &endptr, 10);
+    if (endptr == text || *endptr != '\0' || errno == ERANGE || value < INT32_MIN || value > INT32_MAX) {
+        return -1;
+    }
+    *number = (int32_t)value;
+    return 0;
+}
+
+static const char* graph_usage =
+    "Usage: ema-traverse-graph gen <file> <nodes> <degree> [-f forward_percent] [-s span] [-S seed] [-e posix|vtpc]\n"
+    "       ema-traverse-graph bfs|dfs <file> <value> <replacement> [-d depth] [-r root] [-p] [-e posix|vtpc]\n";
+
+static int graph_generate_command(char** args) {
+    GraphGenOptions options = {0, 50, 0, (uint64_t)time(NULL), IO_ENGINE_POSIX};
+    uint64_t nodes, degree;
+    if (!args[2] || !args[3] || !args[4] || parse_u64(args[3], &nodes) != 0 || parse_u64(args[4], &degree) != 0 ||
+        degree > GRAPH_MAX_DEGREE) {
+        return -1;
+    }
+    options.degree = (uint32_t)degree;
+    for (int i = 5; args[i]; i += 2) {
+        uint64_t number = 0;
+        if (strcmp(args[i], "-e") == 0) {
+            if (parse_engine(args[0], args[i + 1], &options.engine) != 0) {
+                return 0;
             }
+            continue;
+        }
+        if (!args[i + 1] || parse_u64(args[i + 1], &number) != 0) {
+            return -1;
+        }
+        if (strcmp(args[i], "-f") == 0 && number <= 100) {
+            options.forward_percent = (unsigned)number;
+        } else if (strcmp(args[i], "-s") == 0) {
+            options.span = number;
+        } else if (strcmp(args[i], "-S") == 0) {
+            options.seed = number;
+        } else {
+            return -1;
         }
     }
+    if (graph_generate(args[2], nodes, &options) == 0) {
+        printf("Generated %llu nodes of degree %u into %s\n", (unsigned long long)nodes, options.degree, args[2]);
+        print_engine_stats(options.engine);
+    }
+    return 0;
+}
 
-    fprintf(output, "%d\n", count);
-    for (i = 0; i < n1; i++) {
-        for (j = 0; j < n2; j++) {
-            if (table1[i].id == table2[j].id) {
-                fprintf(output, "%d %s %s\n", 
-                       table1[i].id, 
-                       table1[i].word, 
-                       table2[j].word);
+static int graph_search_command(char** args, GraphOrder order) {
+    GraphSearchOptions options = {order, GRAPH_UNLIMITED_DEPTH, 0, false, IO_ENGINE_POSIX};
+    int32_t value, replacement;
+    if (!args[2] || !args[3] || !args[4] || parse_i32(args[3], &value) != 0 ||
+        parse_i32(args[4], &replacement) != 0) {
+        return -1;
+    }
+    for (int i = 5; args[i]; i++) {
+        uint64_t number;
+        if (strcmp(args[i], "-p") == 0) {
+            options.prefetch = true;
+        } else if (strcmp(args[i], "-e") == 0) {
+            if (parse_engine(args[0], args[++i], &options.engine) != 0) {
+                return 0;
             }
+        } else if ((strcmp(args[i], "-d") == 0 || strcmp(args[i], "-r") == 0) && args[i + 1] &&
+                   parse_u64(args[i + 1], &number) == 0 && number <= UINT32_MAX) {
+            *(args[i][1] == 'd' ? &options.depth : &options.root) = (uint32_t)number;
+            i++;
+        } else {
+            return -1;
+        }
+    }
+
+    GraphSearchResult result;
+    if (graph_search(args[2], value, replacement, &options, &result) != 0) {
+        return 0;
+    }
+    if (result.found) {
+        printf("Found %d at node %u (depth %u), replaced with %d\n", value, result.node, result.depth, replacement);
+    } else {
+        printf("Value %d not found\n", value);
+    }
+    printf("Visited %llu nodes over %u levels: %llu reads, %llu bytes\n", (unsigned long long)result.visited,
+           result.levels, (unsigned long long)result.reads, (unsigned long long)result.bytes);
+    print_engine_stats(options.engine);
+    return 0;
+}
+
+/* Usage errors return -1 so the caller prints the usage; other failures report themselves. */
+void execute_ema_traverse_graph(char** args) {
+    int status = -1;
+    reset_engine_stats();
+    if (args[1] && strcmp(args[1], "gen") == 0) {
+        status = graph_generate_command(args);
+    } else if (args[1] && strcmp(args[1], "bfs") == 0) {
+        status = graph_search_command(args, GRAPH_BFS);
+    } else if (args[1] && strcmp(args[1], "dfs") == 0) {
+        status = graph_search_command(args, GRAPH_DFS);
+    }
+    if (status != 0) {
+        fprintf(stderr, "%s", graph_usage);
+    }
+}
+
+typedef struct {
+    uint64_t* numbers;
+    uint64_t (*factors)[FACTOR_MAX];
+    int* counts;
+} FactorizeJob;
+
+static void factorize_one(void* arg, size_t index) {
+    FactorizeJob* job = arg;
+    job->counts[index] = factor_u64(job->numbers[index], job->factors[index]);
+}
+
+static int parse_factorize_number(const char* text, uint64_t* number) {
+    return parse_u64(text, number) == 0 && *number >= 2 ? 0 : -1;
+}
+
+static void factorize_batch(FactorizeJob* job, size_t count, int jobs) {
+    pool_parallel_for(count, jobs, factorize_one, job);
+    for (size_t i = 0; i < count; i++) {
+        printf("%llu =", (unsigned long long)job->numbers[i]);
+        for (int f = 0; f < job->counts[i]; f++) {
+            printf(f == 0 ? " %llu" : " * %llu", (unsigned long long)job->factors[i][f]);
         }
+        printf("\n");
     }
-    
-    free(table1);
-    free(table2);
-    fclose(file1);
-    fclose(file2);
-    fclose(output);
-    printf("Operation completed successfully\n");
 }
 
+/* Reads whitespace-separated numbers and factors them FACTORIZE_BATCH at a time. */
+static void factorize_stream(FactorizeJob* job, FILE* input, int jobs) {
+    char token[32];
+    size_t count = 0;
+    size_t index = 0;
+    int scanned;
+
+    while ((scanned = fscanf(input, "%31s", token)) == 1) {
+        index++;
+        if (parse_factorize_number(token, &job->numbers[count]) != 0) {
+            fprintf(stderr, "factorize: invalid number '%s' at position %zu\n", token, index);
+            break;
+        }
+        if (++count == FACTORIZE_BATCH) {
+            factorize_batch(job, count, jobs);
+            count = 0;
+        }
+    }
+    if (count > 0) {
+        factorize_batch(job, count, jobs);
+    }
+}
 
 void execute_factorize(char** args) {
-    if (args[1] == NULL) {
-        fprintf(stderr, "Usage: factorize <number>\n");
+    int jobs = 1;
+    if (take_jobs_option(args, &jobs) != 0) {
+        return;
+    }
+    if (args[1] == NULL || (strcmp(args[1], "-f") == 0 && !args[2])) {
+        fprintf(stderr, "Usage: factorize [-j N] <number> [number...] | factorize [-j N] -f <file|->\n");
         return;
     }
 
-    char* endptr;
-    errno = 0;
-    long long num = strtoll(args[1], &endptr, 10);
-    
-    if (*endptr != '\0' || errno == ERANGE || num < 2) {
-        fprintf(stderr, "factorize: invalid number\n");
+    int from_file = strcmp(args[1], "-f") == 0;
+    size_t capacity = 0;
+    if (from_file) {
+        capacity = FACTORIZE_BATCH;
+    } else {
+        while (args[capacity + 1]) {
+            capacity++;
+        }
+    }
+
+    FactorizeJob job = {malloc(capacity * sizeof(uint64_t)), malloc(capacity * sizeof(*job.factors)),
+                        malloc(capacity * sizeof(int))};
+    if (!job.numbers || !job.factors || !job.counts) {
+        fprintf(stderr, "factorize: memory allocation failed\n");
+    } else if (from_file) {
+        FILE* input = strcmp(args[2], "-") == 0 ? stdin : fopen(args[2], "r");
+        if (!input) {
+            fprintf(stderr, "factorize: cannot open '%s'\n", args[2]);
+        } else {
+            factorize_stream(&job, input, jobs);
+            if (input == stdin) {
+                clearerr(stdin);
+            } else {
+                fclose(input);
+            }
+        }
+    } else {
+        size_t i;
+        for (i = 0; i < capacity; i++) {
+            if (parse_factorize_number(args[i + 1], &job.numbers[i]) != 0) {
+                fprintf(stderr, "factorize: invalid number\n");
+                break;
+            }
+        }
+        if (i == capacity) {
+            factorize_batch(&job, capacity, jobs);
+        }
+    }
+
+    free(job.numbers);
+    free(job.factors);
+    free(job.counts);
+}
+
+static const char* spawn_bench_usage =
+    "Usage: spawn-bench [-n runs] [-w warmup] [-m ballast] [-b backend] [--] [command args...]\n"
+    "Backends: fork, vfork, clone3, posix_spawn (all of them by default); command defaults to /bin/true\n";
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* Spawns and waits for path runs times, storing each latency in nanoseconds; returns the failed runs. */
+static uint64_t spawn_bench_backend(SpawnBackend backend, const char* path, char** argv, uint64_t runs,
+                                    uint64_t* latencies) {
+    uint64_t failures = 0;
+    for (uint64_t i = 0; i < runs; i++) {
+        int status;
+        uint64_t start = monotonic_ns();
+        pid_t pid = spawn_process(backend, path, argv);
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failures++;
+        }
+        if (latencies) {
+            latencies[i] = monotonic_ns() - start;
+        }
+    }
+    return failures;
+}
+
+static double sorted_percentile_us(const uint64_t* sorted, uint64_t count, double percentile) {
+    uint64_t index = (uint64_t)(percentile / 100.0 * (double)(count - 1) + 0.5);
+    return (double)sorted[index] / 1000.0;
+}
+
+/*
+ * Latency of starting a process and waiting for it with each spawn backend.
+ * -m allocates and touches a ballast first, so the shell's RSS resembles
+ * one that has run the memory-hungry builtins.
+ */
+void execute_spawn_bench(char** args) {
+    uint64_t runs = SPAWN_BENCH_RUNS, warmup = SPAWN_BENCH_WARMUP;
+    size_t ballast_size = 0;
+    int only = -1;
+    int i;
+    for (i = 1; args[i] && args[i][0] == '-'; i += 2) {
+        if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        }
+        const char* option = args[i];
+        const char* value = args[i + 1];
+        SpawnBackend backend;
+        int status = -1;
+        if (!value) {
+            status = -1;
+        } else if (strcmp(option, "-n") == 0) {
+            status = parse_u64(value, &runs) == 0 && runs > 0 ? 0 : -1;
+        } else if (strcmp(option, "-w") == 0) {
+            status = parse_u64(value, &warmup);
+        } else if (strcmp(option, "-m") == 0) {
+            status = parse_memory_size(value, &ballast_size);
+        } else if (strcmp(option, "-b") == 0 && spawn_backend_parse(value, &backend) == 0) {
+            only = (int)backend;
+            status = 0;
+        }
+        if (status != 0) {
+            fprintf(stderr, "%s", spawn_bench_usage);
+            return;
+        }
+    }
+    char* default_command[] = {"/bin/true", NULL};
+    char** command = args[i] ? &args[i] : default_command;
+    /* PATH is searched once up front, so only the spawn itself is measured. */
+    const char* path = path_cache_lookup(command[0]);
+    if (!path) {
+        fprintf(stderr, "spawn-bench: %s: command not found\n", command[0]);
         return;
     }
 
-    printf("%lld = ", num);
-    int first = 1;
-    long long divisor = 2;
+    char* ballast = NULL;
+    uint64_t* latencies = malloc(runs * sizeof(uint64_t));
+    if (ballast_size > 0) {
+        ballast = malloc(ballast_size);
+        if (ballast) {
+            memset(ballast, 1, ballast_size);
+        }
+    }
+    if (!latencies || (ballast_size > 0 && !ballast)) {
+        fprintf(stderr, "spawn-bench: memory allocation failed\n");
+        free(latencies);
+        free(ballast);
+        return;
+    }
+
+    printf("spawn-bench: %llu runs of %s, %zu MiB ballast\n", (unsigned long long)runs, command[0],
+           ballast_size >> 20);
+    printf("%-12s %10s %10s %10s %10s %10s\n", "backend", "mean us", "p50 us", "p99 us", "p99.9 us", "max us");
+    fflush(stdout);
+    for (int backend = 0; backend < SPAWN_BACKEND_COUNT; backend++) {
+        if (only >= 0 && backend != only) {
+            continue;
+        }
+        spawn_bench_backend((SpawnBackend)backend, path, command, warmup, NULL);
+        uint64_t failures = spawn_bench_backend((SpawnBackend)backend, path, command, runs, latencies);
+
+        uint64_t total = 0;
+        for (uint64_t j = 0; j < runs; j++) {
+            total += latencies[j];
+        }
+        qsort(latencies, runs, sizeof(uint64_t), compare_u64);
+        printf("%-12s %10.1f %10.1f %10.1f %10.1f %10.1f", spawn_backend_name((SpawnBackend)backend),
+               (double)total / (double)runs / 1000.0, sorted_percentile_us(latencies, runs, 50),
+               sorted_percentile_us(latencies, runs, 99), sorted_percentile_us(latencies, runs, 99.9),
+               (double)latencies[runs - 1] / 1000.0);
+        if (failures > 0) {
+            printf("  (%llu failed)", (unsigned long long)failures);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    free(latencies);
+    free(ballast);
+}
+
+static const char* bench_usage =
+    "Usage: bench [-n runs] [-w warmup] [-j parallel] [--] <command> [args...]\n";
+
+static double timeval_ms(const struct timeval* time) {
+    return (double)time->tv_sec * 1000.0 + (double)time->tv_usec / 1000.0;
+}
+
+static double rusage_cpu_ms(const struct rusage* usage) {
+    return timeval_ms(&usage->ru_utime) + timeval_ms(&usage->ru_stime);
+}
+
+/* Builtins such as factorize rearrange their argv, so every run gets a fresh copy. */
+static void run_builtin_copy(const BuiltinCommand* builtin, char** argv) {
+    size_t count = 0;
+    while (argv[count]) {
+        count++;
+    }
+    char** copy = malloc((count + 1) * sizeof(char*));
+    if (!copy) {
+        fprintf(stderr, "bench: memory allocation failed\n");
+        return;
+    }
+    memcpy(copy, argv, (count + 1) * sizeof(char*));
+    builtin->function(copy);
+    free(copy);
+}
+
+/* One run in the foreground, with the shell's spawn backend for an external command. Returns 0 on success. */
+static int bench_run(const BuiltinCommand* builtin, const char* path, char** argv, double* cpu_ms) {
+    struct rusage before, after;
+    if (builtin) {
+        getrusage(RUSAGE_SELF, &before);
+        run_builtin_copy(builtin, argv);
+        getrusage(RUSAGE_SELF, &after);
+        *cpu_ms = rusage_cpu_ms(&after) - rusage_cpu_ms(&before);
+        return 0;
+    }
 
-    while (num > 1) {
-        if (num % divisor == 0) {
-            if (!first) {
-                printf(" * ");
+    int status;
+    fflush(NULL);
+    pid_t pid = spawn_process(shell_config.spawn_backend, path, argv);
+    if (pid < 0 || wait4(pid, &status, 0, &after) < 0) {
+        *cpu_ms = 0.0;
+        return -1;
+    }
+    *cpu_ms = rusage_cpu_ms(&after);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/*
+ * Forks jobs copies that block on a pipe until all of them exist, so they
+ * start together; closing it is the starting signal. Builtins run in the
+ * forked shells. Returns the number of copies that failed.
+ */
+static int bench_run_parallel(const BuiltinCommand* builtin, const char* path, char** argv, int jobs,
+                              uint64_t* start, double* cpu_ms) {
+    int go[2];
+    *cpu_ms = 0.0;
+    pid_t* pids = malloc((size_t)jobs * sizeof(pid_t));
+    if (!pids || pipe(go) != 0) {
+        perror("bench");
+        free(pids);
+        return jobs;
+    }
+    fflush(NULL);
+    int started = 0;
+    for (; started < jobs; started++) {
+        pids[started] = fork();
+        if (pids[started] < 0) {
+            perror("bench: fork");
+            break;
+        }
+        if (pids[started] == 0) {
+            char signal;
+            close(go[1]);
+            while (read(go[0], &signal, 1) < 0 && errno == EINTR) {
             }
-            printf("%lld", divisor);
-            num /= divisor;
-            first = 0;
-        } else {
-            divisor++;
+            close(go[0]);
+            if (builtin) {
+                run_builtin_copy(builtin, argv);
+                fflush(NULL);
+                _exit(0);
+            }
+            execv(path, argv);
+            perror("exec failed");
+            _exit(SPAWN_EXEC_FAILED);
         }
     }
-    printf("\n");
-}
\ No newline at end of file
+    *start = monotonic_ns();
+    close(go[1]);
+    close(go[0]);
+
+    /* Waiting for the pids themselves leaves background jobs to reap_background_jobs. */
+    int failed = jobs - started;
+    for (int i = 0; i < started; i++) {
+        int status;
+        struct rusage usage;
+        if (wait4(pids[i], &status, 0, &usage) < 0) {
+            failed++;
+            continue;
+        }
+        *cpu_ms += rusage_cpu_ms(&usage);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed++;
+        }
+    }
+    free(pids);
+    return failed;
+}
+
+/*
+ * Runs a command repeatedly and summarizes the wall time of each run (of
+ * the whole batch with -j) and the CPU time it used. Outliers are runs
+ * beyond 1.5 interquartile ranges from the quartiles (Tukey's fences).
+ */
+void execute_bench(char** args) {
+    uint64_t runs = BENCH_RUNS, warmup = BENCH_WARMUP, jobs = 1;
+    int i;
+    for (i = 1; args[i] && args[i][0] == '-'; i += 2) {
+        if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        }
+        const char* option = args[i];
+        const char* value = args[i + 1];
+        int status = -1;
+        if (!value) {
+            status = -1;
+        } else if (strcmp(option, "-n") == 0) {
+            status = parse_u64(value, &runs) == 0 && runs > 0 ? 0 : -1;
+        } else if (strcmp(option, "-w") == 0) {
+            status = parse_u64(value, &warmup);
+        } else if (strcmp(option, "-j") == 0) {
+            status = parse_u64(value, &jobs) == 0 && jobs > 0 && jobs <= BENCH_MAX_JOBS ? 0 : -1;
+        }
+        if (status != 0) {
+            fprintf(stderr, "%s", bench_usage);
+            return;
+        }
+    }
+    char** command = &args[i];
+    if (!command[0]) {
+        fprintf(stderr, "%s", bench_usage);
+        return;
+    }
+    const BuiltinCommand* builtin = find_builtin(command[0]);
+    const char* path = builtin ? NULL : path_cache_lookup(command[0]);
+    if (builtin && builtin->function == execute_exit) {
+        fprintf(stderr, "bench: cannot benchmark exit\n");
+        return;
+    }
+    if (!builtin && !path) {
+        fprintf(stderr, "bench: %s: command not found\n", command[0]);
+        return;
+    }
+
+    uint64_t* wall = malloc(runs * sizeof(uint64_t));
+    double* cpu = malloc(runs * sizeof(double));
+    if (!wall || !cpu) {
+        fprintf(stderr, "bench: memory allocation failed\n");
+        free(wall);
+        free(cpu);
+        return;
+    }
+
+    uint64_t failed = 0;
+    for (uint64_t run = 0; run < warmup + runs; run++) {
+        double cpu_ms;
+        uint64_t start = monotonic_ns();
+        int run_failed = jobs > 1 ? bench_run_parallel(builtin, path, command, (int)jobs, &start, &cpu_ms)
+                                  : (bench_run(builtin, path, command, &cpu_ms) != 0);
+        uint64_t elapsed = monotonic_ns() - start;
+        if (run >= warmup) {
+            wall[run - warmup] = elapsed;
+            cpu[run - warmup] = cpu_ms;
+            failed += (uint64_t)run_failed;
+        }
+    }
+
+    double sum = 0.0, cpu_sum = 0.0;
+    for (uint64_t j = 0; j < runs; j++) {
+        sum += (double)wall[j] / 1e6;
+        cpu_sum += cpu[j];
+    }
+    double mean = sum / (double)runs;
+    double variance = 0.0;
+    for (uint64_t j = 0; j < runs; j++) {
+        double delta = (double)wall[j] / 1e6 - mean;
+        variance += delta * delta;
+    }
+    double stddev = runs > 1 ? sqrt(variance / (double)(runs - 1)) : 0.0;
+    qsort(wall, runs, sizeof(uint64_t), compare_u64);
+
+    double min = (double)wall[0] / 1e6;
+    double median = sorted_percentile_us(wall, runs, 50) / 1000.0;
+    double p95 = sorted_percentile_us(wall, runs, 95) / 1000.0;
+    double max = (double)wall[runs - 1] / 1e6;
+    double q1 = sorted_percentile_us(wall, runs, 25) / 1000.0;
+    double q3 = sorted_percentile_us(wall, runs, 75) / 1000.0;
+    uint64_t low = 0, high = 0;
+    for (uint64_t j = 0; runs >= BENCH_MIN_OUTLIER_RUNS && j < runs; j++) {
+        double ms = (double)wall[j] / 1e6;
+        low += ms < q1 - 1.5 * (q3 - q1);
+        high += ms > q3 + 1.5 * (q3 - q1);
+    }
+    double cpu_mean = cpu_sum / (double)runs;
+
+    printf("bench: %llu runs of %s after %llu warmup, %llu %s at a time\n", (unsigned long long)runs, command[0],
+           (unsigned long long)warmup, (unsigned long long)jobs, jobs == 1 ? "copy" : "copies");
+    printf("  wall: min %.3f ms, median %.3f ms, mean %.3f ms +- %.3f ms, p95 %.3f ms, max %.3f ms\n", min, median,
+           mean, stddev, p95, max);
+    printf("  cpu: %.3f ms user+sys per run, %.2f CPUs busy\n", cpu_mean, mean > 0 ? cpu_mean / mean : 0.0);
+    if (low + high > 0) {
+        printf("  warning: %llu outliers (%llu low, %llu high); add warmup runs or quiet the system\n",
+               (unsigned long long)(low + high), (unsigned long long)low, (unsigned long long)high);
+    }
+    if (failed > 0) {
+        printf("  warning: %llu of %llu %s exited with a non-zero status\n", (unsigned long long)failed,
+               (unsigned long long)(runs * jobs), jobs == 1 ? "runs" : "copies");
+    }
+    printf("bench-summary command=%s runs=%llu warmup=%llu jobs=%llu min_ms=%.3f median_ms=%.3f mean_ms=%.3f "
+           "stddev_ms=%.3f p95_ms=%.3f max_ms=%.3f cpu_ms=%.3f cpus=%.2f outliers=%llu failed=%llu\n",
+           command[0], (unsigned long long)runs, (unsigned long long)warmup, (unsigned long long)jobs, min, median,
+           mean, stddev, p95, max, cpu_mean, mean > 0 ? cpu_mean / mean : 0.0, (unsigned long long)(low + high),
+           (unsigned long long)failed);
+
+    free(wall);
+    free(cpu);
+}
+
+static void print_hash_entry(const char* name, const char* path, size_t hits, void* arg) {
+    (void)name;
+    (void)arg;
+    printf("%4zu\t%s\n", hits, path);
+}
+
+/*
+ * hash           lists the remembered commands with their hit counts
+ * hash -r        forgets them all
+ * hash name...   looks the names up in PATH and remembers them
+ */
+void execute_hash(char** args) {
+    if (args[1] && strcmp(args[1], "-r") == 0) {
+        if (args[2]) {
+            fprintf(stderr, "Usage: hash [-r] [name...]\n");
+            return;
+        }
+        path_cache_clear();
+        return;
+    }
+    if (args[1]) {
+        for (int i = 1; args[i]; i++) {
+            if (!path_cache_lookup(args[i])) {
+                fprintf(stderr, "hash: %s: not found\n", args[i]);
+            }
+        }
+        return;
+    }
+    if (path_cache_size() == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+    printf("hits\tcommand\n");
+    path_cache_foreach(print_hash_entry, NULL);
+}
@@ -3,74 +3,87 @@
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
-#include <sys/time.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include "command.h"
+#include "pathcache.h"
+#include "profile.h"
 
-Command* create_command(char* input) {
-    Command* cmd = malloc(sizeof(Command));
-    if (!cmd) {
-        return NULL;
+ShellConfig shell_config = {true, true, false, NULL, SPAWN_FORK, NULL, NULL};
+
+/* Anything still buffered would otherwise be written by the child as well. */
+static void prepare_fork(void) {
+    if (shell_config.before_fork) {
+        shell_config.before_fork(shell_config.before_fork_arg);
     }
+    fflush(NULL);
+}
 
-    cmd->argc = 0;
-    
-    char* token = strtok(input, " \n");
-    while (token != NULL && cmd->argc < MAX_ARGS - 1) {
-        cmd->args[cmd->argc++] = token;
-        token = strtok(NULL, " \n");
+static void print_timing(const CommandProfile* profile) {
+    if (shell_config.print_timing || shell_config.profile) {
+        printf("Execution time: %.4f ms\n", profile->wall_ms);
+    }
+    if (shell_config.profile) {
+        profile_print(profile);
     }
-    cmd->args[cmd->argc] = NULL;
+}
 
-    if (cmd->argc == 0) {
-        free_command(cmd);
-        return NULL;
+static int exit_status(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
     }
-    
-    cmd->name = cmd->args[0];
-    return cmd;
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : 1;
 }
 
-void free_command(Command* cmd) {
-    free(cmd);
+/* Resolves a command through the PATH cache, reporting names that are nowhere in PATH. */
+static const char* resolve_command(const char* name) {
+    const char* path = path_cache_lookup(name);
+    if (!path) {
+        printf("Command not found\n");
+    }
+    return path;
 }
 
-void execute_external(char* args[]) {
+static int execute_external(char* args[]) {
     int status = 0;
 
     if (args[0] == NULL) {
         printf("Error: No command provided\n");
-        return;
+        return 1;
+    }
+    const char* path = resolve_command(args[0]);
+    if (!path) {
+        return SPAWN_EXEC_FAILED;
     }
 
-    pid_t pid = fork();
+    ProfileScope scope;
+    CommandProfile profile;
+    struct rusage usage;
+
+    prepare_fork();
+    profile_begin(&scope);
+    pid_t pid = spawn_process(shell_config.spawn_backend, path, args);
     if (pid < 0) {
-        perror("fork failed");
-        return;
+        path_cache_check(args[0]);
+        return SPAWN_EXEC_FAILED;
     }
-
-    if (pid == 0) {
-        execvp(args[0], args);
-        
-        perror("exec failed");  
-        _exit(EXIT_FAILURE);
-    }
-    
-    if (pid > 0) {
-        struct timeval start, end;
-        long long start_time, end_time;
-    
-        gettimeofday(&start, NULL);
-        waitpid(pid, &status, 0);
-        gettimeofday(&end, NULL);
-
-        start_time = start.tv_sec * 1000000 + start.tv_usec;
-        end_time = end.tv_sec * 1000000 + end.tv_usec;
-        
-        double time_taken_ms = ((double)(end_time - start_time)) / 1000.0;
-        printf("Execution time: %.4f ms\n", time_taken_ms);
+    if (shell_config.monitor) {
+        /* The end sample still reads the child's /proc entry, so it is reaped only after. */
+        siginfo_t info;
+        monitor_begin(shell_config.monitor, args[0], pid);
+        waitid(P_PID, (id_t)pid, &info, WEXITED | WNOWAIT);
+        monitor_end(shell_config.monitor);
+    }
+    wait4(pid, &status, 0, &usage);
+    profile_end(&scope, &usage, &profile);
+    print_timing(&profile);
+    /* The remembered file may be gone (ENOENT); the next run then searches PATH again. */
+    status = exit_status(status);
+    if (status == SPAWN_EXEC_FAILED) {
+        path_cache_check(args[0]);
     }
+    return status;
 }
 
 BuiltinCommand builtins[] = {
@@ -78,34 +91,105 @@ BuiltinCommand builtins[] = {
     {"mat-mul", execute_mat_mul},
     {"calc-md5", execute_calc_md5},
     {"ema-join-inner", execute_ema_join_inner},
+    {"ema-table-convert", execute_ema_table_convert},
+    {"ema-sort-int", execute_ema_sort_int},
+    {"ema-traverse-graph", execute_ema_traverse_graph},
     {"factorize", execute_factorize},
+    {"spawn-bench", execute_spawn_bench},
+    {"bench", execute_bench},
+    {"hash", execute_hash},
     {NULL, NULL}
 };
 
-void execute_command(Command* cmd) {
+const BuiltinCommand* find_builtin(const char* name) {
+    for (size_t i = 0; builtins[i].name != NULL; i++) {
+        if (strcmp(name, builtins[i].name) == 0) {
+            return &builtins[i];
+        }
+    }
+    return NULL;
+}
+
+int execute_command(Command* cmd) {
     if (cmd->argc == 0) {
-        return;  
-    }
-
-    struct timeval start, end;
-    long long start_time, end_time;
-    
-    gettimeofday(&start, NULL);
-
-    size_t i;
-
-    for (i = 0; builtins[i].name != NULL; i++) {
-        if (strcmp(cmd->name, builtins[i].name) == 0) {
-            builtins[i].function(cmd->args);
-            
-            gettimeofday(&end, NULL);
-            start_time = start.tv_sec * 1000000 + start.tv_usec;
-            end_time = end.tv_sec * 1000000 + end.tv_usec;
-            double time_taken_ms = ((double)(end_time - start_time)) / 1000.0;
-            printf("Execution time: %.4f ms\n", time_taken_ms);
-            return;
+        return 0;
+    }
+
+    const BuiltinCommand* builtin = find_builtin(cmd->name);
+    if (!builtin) {
+        return execute_external(cmd->args);
+    }
+
+    ProfileScope scope;
+    CommandProfile profile;
+
+    profile_begin(&scope);
+    if (shell_config.monitor) {
+        monitor_begin(shell_config.monitor, cmd->name, getpid());
+    }
+    builtin->function(cmd->args);
+    if (shell_config.monitor) {
+        monitor_end(shell_config.monitor);
+    }
+    profile_end(&scope, NULL, &profile);
+    print_timing(&profile);
+    return 0;
+}
+
+/*
+ * The job runs in its own process. An external command is started with the
+ * configured spawn backend; builtins and compound lists need a forked shell.
+ */
+static int execute_background(AstNode* node) {
+    prepare_fork();
+    pid_t pid;
+    if (node->type == AST_COMMAND && !find_builtin(node->command.name)) {
+        const char* path = resolve_command(node->command.name);
+        pid = path ? spawn_process(shell_config.spawn_backend, path, node->command.args) : -1;
+        if (pid < 0) {
+            return SPAWN_EXEC_FAILED;
+        }
+    } else if ((pid = fork()) < 0) {
+        perror("fork failed");
+        return 1;
+    }
+    if (pid == 0) {
+        int status = execute_tree(node);
+        fflush(NULL);
+        _exit(status);
+    }
+    if (shell_config.report_jobs) {
+        printf("[%d]\n", (int)pid);
+    }
+    return 0;
+}
+
+int execute_tree(AstNode* node) {
+    int status;
+    switch (node->type) {
+    case AST_COMMAND:
+        return execute_command(&node->command);
+    case AST_AND:
+        status = execute_tree(node->left);
+        return status == 0 ? execute_tree(node->right) : status;
+    case AST_OR:
+        status = execute_tree(node->left);
+        return status != 0 ? execute_tree(node->right) : status;
+    case AST_SEQUENCE:
+        execute_tree(node->left);
+        return execute_tree(node->right);
+    case AST_BACKGROUND:
+        return execute_background(node->left);
+    }
+    return 1;
+}
+
+void reap_background_jobs(void) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        if (shell_config.report_jobs) {
+            printf("[%d] Done (status %d)\n", (int)pid, exit_status(status));
         }
     }
-    
-    execute_external(cmd->args);
 }
@@ -1,29 +1,57 @@
 #ifndef COMMAND_H
 #define COMMAND_H
 
-#define MAX_CMD_LENGTH 1024
-#define MAX_ARGS 10
-#define SEC_TO_MICROSEC 1000.0
+#include <stdbool.h>
+#include "monitor.h"
+#include "parser.h"
+#include "process.h"
 
-typedef struct {
-    char* name;
-    char* args[MAX_ARGS];
-    int argc;
-} Command;
+#define SEC_TO_MICROSEC 1000.0
 
 typedef struct {
     char* name;
     void (*function)(char** args);
 } BuiltinCommand;
 
-Command* create_command(char* input);
-void execute_command(Command* cmd);
-void free_command(Command* cmd);
+/* How the shell reports on the commands it runs; main sets it up from the mode it runs in. */
+typedef struct {
+    bool print_timing;
+    bool report_jobs;
+    /* Print CPU time, context switches, faults and perf counters after every command. */
+    bool profile;
+    /* Records a /proc timeline of every foreground command when set. */
+    Monitor* monitor;
+    /* How external commands are started. */
+    SpawnBackend spawn_backend;
+    /* Called before every fork, e.g. to hand unread script input back to a shared stdin. */
+    void (*before_fork)(void* arg);
+    void* before_fork_arg;
+} ShellConfig;
+
+extern ShellConfig shell_config;
+
+/* Runs one command in the foreground and returns its exit status; builtins always succeed. */
+int execute_command(Command* cmd);
+
+/* Evaluates a parsed line with sh semantics for &&, ||, ; and & and returns the last status. */
+int execute_tree(AstNode* node);
+
+/* Returns the builtin called name, or NULL for an external command. */
+const BuiltinCommand* find_builtin(const char* name);
+
+/* Collects background jobs that have finished since the last call and reports them. */
+void reap_background_jobs(void);
 
 void execute_exit(char** args);
 void execute_mat_mul(char** args);
 void execute_calc_md5(char** args);
 void execute_ema_join_inner(char** args);
+void execute_ema_table_convert(char** args);
+void execute_ema_sort_int(char** args);
+void execute_ema_traverse_graph(char** args);
 void execute_factorize(char** args);
+void execute_spawn_bench(char** args);
+void execute_bench(char** args);
+void execute_hash(char** args);
 
 #endif
\ No newline at end of file
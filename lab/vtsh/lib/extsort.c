@@ -0,0 +1,539 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "extsort.h"
+#include "loser_tree.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+/* Flipping the sign bit makes unsigned digit order match signed order. */
+#define SIGN_FLIP ((uint64_t)1 << 63)
+#define MIN_FAN_IN 2
+#define VALUES_PER_PAGE (IO_ALIGNMENT / sizeof(int64_t))
+
+typedef struct {
+    IoQueue* queue;
+    size_t buffer_size;
+    int slots;
+} SortIo;
+
+/* Sequential reader over [offset, end) of a file, one buffer per slot. */
+typedef struct {
+    IoFile* file;
+    off_t offset;
+    off_t end;
+    int64_t* buffers[2];
+    IoRequest requests[2];
+    int slot;
+    size_t length;
+    size_t position;
+    bool failed;
+} RunCursor;
+
+static void cursor_request(SortIo* io, RunCursor* cursor, int slot) {
+    off_t left = cursor->end - cursor->offset;
+    IoRequest* request = &cursor->requests[slot];
+    request->file = cursor->file;
+    request->writing = false;
+    request->buffer = cursor->buffers[slot];
+    request->length = (size_t)left < io->buffer_size ? (size_t)left : io->buffer_size;
+    request->offset = cursor->offset;
+    cursor->offset += (off_t)request->length;
+    io_submit(io->queue, request);
+}
+
+static bool cursor_load(SortIo* io, RunCursor* cursor, int slot) {
+    if (io_wait(io->queue, &cursor->requests[slot]) != 0) {
+        cursor->failed = true;
+        return false;
+    }
+    cursor->slot = slot;
+    cursor->length = cursor->requests[slot].length / sizeof(int64_t);
+    cursor->position = 0;
+    return cursor->length > 0;
+}
+
+static bool cursor_start(SortIo* io, RunCursor* cursor, IoFile* file, off_t begin, off_t end) {
+    cursor->file = file;
+    cursor->offset = begin;
+    cursor->end = end;
+    cursor->failed = false;
+    for (int slot = 0; slot < io->slots; slot++) {
+        cursor_request(io, cursor, slot);
+    }
+    return cursor_load(io, cursor, 0);
+}
+
+/*
+ * Called once the current buffer is used up. With two slots the drained
+ * buffer is queued for the block after the one already in flight, which
+ * keeps exactly one read ahead per run.
+ */
+static bool cursor_advance(SortIo* io, RunCursor* cursor) {
+    int slot = cursor->slot;
+    cursor_request(io, cursor, slot);
+    return cursor_load(io, cursor, io->slots == 2 ? 1 - slot : slot);
+}
+
+static void cursor_drain(SortIo* io, RunCursor* cursor) {
+    for (int slot = 0; slot < io->slots; slot++) {
+        io_wait(io->queue, &cursor->requests[slot]);
+    }
+}
+
+/* Sequential writer from offset on; a full buffer is handed off and the other slot is filled. */
+typedef struct {
+    IoFile* file;
+    off_t offset;
+    int64_t* buffers[2];
+    IoRequest requests[2];
+    int slot;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} RunWriter;
+
+static void writer_start(SortIo* io, RunWriter* writer, IoFile* file, off_t offset) {
+    writer->file = file;
+    writer->offset = offset;
+    writer->slot = 0;
+    writer->length = 0;
+    writer->capacity = io->buffer_size / sizeof(int64_t);
+    writer->failed = false;
+}
+
+static void writer_flush(SortIo* io, RunWriter* writer) {
+    if (writer->length == 0) {
+        return;
+    }
+    IoRequest* request = &writer->requests[writer->slot];
+    request->file = writer->file;
+    request->writing = true;
+    request->buffer = writer->buffers[writer->slot];
+    request->length = writer->length * sizeof(int64_t);
+    request->offset = writer->offset;
+    writer->offset += (off_t)request->length;
+    io_submit(io->queue, request);
+
+    /* The next slot may still be on its way to disk from the previous flush. */
+    writer->slot = (writer->slot + 1) % io->slots;
+    if (io_wait(io->queue, &writer->requests[writer->slot]) != 0) {
+        writer->failed = true;
+    }
+    writer->length = 0;
+}
+
+static inline void writer_put(SortIo* io, RunWriter* writer, int64_t value) {
+    writer->buffers[writer->slot][writer->length++] = value;
+    if (writer->length == writer->capacity) {
+        writer_flush(io, writer);
+    }
+}
+
+static int writer_finish(SortIo* io, RunWriter* writer) {
+    writer_flush(io, writer);
+    for (int slot = 0; slot < io->slots; slot++) {
+        if (io_wait(io->queue, &writer->requests[slot]) != 0) {
+            writer->failed = true;
+        }
+    }
+    return writer->failed ? -1 : 0;
+}
+
+/* Requests start out finished and empty, so waiting on a slot that was never used returns at once. */
+static void requests_reset(IoRequest* requests) {
+    for (int slot = 0; slot < 2; slot++) {
+        memset(&requests[slot], 0, sizeof(IoRequest));
+        requests[slot].done = true;
+    }
+}
+
+/* splitmix64 finalizer: the generator's output function and the checksum's mixer. */
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static size_t buffer_bytes(const SortOptions* options) {
+    size_t size = options->buffer_size ? options->buffer_size : SORT_DEFAULT_BUFFER_SIZE;
+    return (size + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+}
+
+/* Opens path and checks that it holds whole int64 values. */
+static int open_values(IoFile* file, const char* path, const SortOptions* options, uint64_t* count) {
+    if (io_file_open(file, path, O_RDONLY, options->engine) != 0) {
+        fprintf(stderr, "ema-sort-int: cannot open '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    off_t size = io_file_size(file);
+    if (size < 0 || size % (off_t)sizeof(int64_t) != 0) {
+        fprintf(stderr, "ema-sort-int: '%s' is not a file of int64 values\n", path);
+        io_file_close(file);
+        return -1;
+    }
+    *count = (uint64_t)size / sizeof(int64_t);
+    return 0;
+}
+
+int sort_generate(const char* path, uint64_t count, uint64_t seed, const SortOptions* options) {
+    IoFile file;
+    if (io_file_open(&file, path, O_WRONLY | O_CREAT | O_TRUNC, options->engine) != 0) {
+        fprintf(stderr, "ema-sort-int: cannot create '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    IoQueue queue;
+    SortIo io = {&queue, buffer_bytes(options), options->double_buffer ? 2 : 1};
+    char* arena = io_alloc((size_t)io.slots * io.buffer_size);
+    int status = -1;
+    if (!arena) {
+        fprintf(stderr, "ema-sort-int: memory allocation failed\n");
+    } else {
+        io_start(&queue, options->double_buffer);
+        RunWriter writer;
+        requests_reset(writer.requests);
+        for (int slot = 0; slot < io.slots; slot++) {
+            writer.buffers[slot] = (int64_t*)(arena + (size_t)slot * io.buffer_size);
+        }
+        writer_start(&io, &writer, &file, 0);
+        uint64_t state = seed;
+        for (uint64_t i = 0; i < count; i++) {
+            state += 0x9e3779b97f4a7c15ULL;
+            writer_put(&io, &writer, (int64_t)mix64(state));
+        }
+        status = writer_finish(&io, &writer);
+        io_stop(&queue);
+        if (status != 0) {
+            fprintf(stderr, "ema-sort-int: writing '%s' failed\n", path);
+        }
+    }
+
+    free(arena);
+    if (io_file_close(&file) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+/* LSD radix sort on sign-flipped keys; digits shared by the whole run are skipped. */
+static void radix_sort(int64_t* data, int64_t* scratch, size_t count) {
+    size_t histogram[RADIX_PASSES][RADIX_BUCKETS];
+    if (count < 2) {
+        return;
+    }
+    memset(histogram, 0, sizeof(histogram));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = (uint64_t)data[i] ^ SIGN_FLIP;
+        for (int pass = 0; pass < RADIX_PASSES; pass++) {
+            histogram[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    int64_t* source = data;
+    int64_t* target = scratch;
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        int shift = pass * RADIX_BITS;
+        size_t* offsets = histogram[pass];
+        if (offsets[(((uint64_t)source[0] ^ SIGN_FLIP) >> shift) & (RADIX_BUCKETS - 1)] == count) {
+            continue;
+        }
+        size_t sum = 0;
+        for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+            size_t size = offsets[bucket];
+            offsets[bucket] = sum;
+            sum += size;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint64_t key = (uint64_t)source[i] ^ SIGN_FLIP;
+            target[offsets[(key >> shift) & (RADIX_BUCKETS - 1)]++] = source[i];
+        }
+        int64_t* swap = source;
+        source = target;
+        target = swap;
+    }
+    if (source != data) {
+        memcpy(data, source, count * sizeof(int64_t));
+    }
+}
+
+/*
+ * Sorts the input capacity values at a time and writes every run to the
+ * byte range it came from, so run r starts at r * capacity values.
+ */
+static int form_runs(IoFile* input, IoFile* runs, uint64_t count, size_t capacity, SortStats* stats) {
+    int64_t* data = io_alloc(capacity * sizeof(int64_t));
+    int64_t* scratch = io_alloc(capacity * sizeof(int64_t));
+    int status = 0;
+    if (!data || !scratch) {
+        fprintf(stderr, "ema-sort-int: memory allocation failed for the run buffer\n");
+        status = -1;
+    }
+
+    for (uint64_t first = 0; first < count && status == 0; first += capacity) {
+        size_t length = count - first < capacity ? (size_t)(count - first) : capacity;
+        size_t bytes = length * sizeof(int64_t);
+        off_t offset = (off_t)(first * sizeof(int64_t));
+        if (io_file_transfer(input, false, data, bytes, offset) != (ssize_t)bytes) {
+            fprintf(stderr, "ema-sort-int: reading input failed\n");
+            status = -1;
+            break;
+        }
+        for (size_t i = 0; i < length; i++) {
+            stats->checksum += mix64((uint64_t)data[i]);
+        }
+        radix_sort(data, scratch, length);
+        if (io_file_transfer(runs, true, data, bytes, offset) != (ssize_t)bytes) {
+            fprintf(stderr, "ema-sort-int: writing run failed\n");
+            status = -1;
+        }
+    }
+
+    free(data);
+    free(scratch);
+    return status;
+}
+
+/* k-way merge of runs [starts[i], starts[i + 1]) for i < count into target at offset. */
+static int merge_group(SortIo* io, char* arena, IoFile* source, const off_t* starts, size_t count,
+                       IoFile* target, off_t offset) {
+    RunCursor* cursors = calloc(count, sizeof(RunCursor));
+    int64_t* keys = calloc(count + 1, sizeof(int64_t));
+    bool* done = calloc(count + 1, sizeof(bool));
+    LoserTree tree = {0};
+    if (!cursors || !keys || !done) {
+        fprintf(stderr, "ema-sort-int: memory allocation failed for the merge\n");
+        free(cursors);
+        free(keys);
+        free(done);
+        return -1;
+    }
+
+    size_t buffer = 0;
+    for (size_t i = 0; i < count; i++) {
+        RunCursor* cursor = &cursors[i];
+        requests_reset(cursor->requests);
+        for (int slot = 0; slot < io->slots; slot++) {
+            cursor->buffers[slot] = (int64_t*)(arena + buffer++ * io->buffer_size);
+        }
+        done[i] = !cursor_start(io, cursor, source, starts[i], starts[i + 1]);
+        keys[i] = done[i] ? 0 : cursor->buffers[cursor->slot][0];
+    }
+    RunWriter writer;
+    requests_reset(writer.requests);
+    for (int slot = 0; slot < io->slots; slot++) {
+        writer.buffers[slot] = (int64_t*)(arena + buffer++ * io->buffer_size);
+    }
+    writer_start(io, &writer, target, offset);
+
+    int status = loser_tree_init(&tree, count, keys, done);
+    if (status != 0) {
+        fprintf(stderr, "ema-sort-int: memory allocation failed for the merge\n");
+    }
+    while (status == 0 && !writer.failed) {
+        size_t winner = loser_tree_winner(&tree);
+        if (done[winner]) {
+            break;
+        }
+        RunCursor* cursor = &cursors[winner];
+        writer_put(io, &writer, cursor->buffers[cursor->slot][cursor->position++]);
+        if (cursor->position == cursor->length && !cursor_advance(io, cursor)) {
+            done[winner] = true;
+        } else {
+            keys[winner] = cursor->buffers[cursor->slot][cursor->position];
+        }
+        loser_tree_replay(&tree, winner);
+    }
+
+    /* Buffers are reused by the next group, so nothing may still be in flight. */
+    for (size_t i = 0; i < count; i++) {
+        cursor_drain(io, &cursors[i]);
+        if (cursors[i].failed) {
+            status = -1;
+        }
+    }
+    if (writer_finish(io, &writer) != 0) {
+        status = -1;
+    }
+    if (status != 0) {
+        fprintf(stderr, "ema-sort-int: merge I/O failed\n");
+    }
+
+    loser_tree_free(&tree);
+    free(cursors);
+    free(keys);
+    free(done);
+    return status;
+}
+
+/* Spill files live next to the output so they are on the same device; they are unlinked right away. */
+static int open_spill(IoFile* file, const char* output, int index, IoEngine engine) {
+    size_t length = strlen(output) + 16;
+    char* path = malloc(length);
+    if (!path) {
+        return -1;
+    }
+    snprintf(path, length, "%s.run%d", output, index);
+    int status = io_file_open(file, path, O_RDWR | O_CREAT | O_TRUNC, engine);
+    if (status != 0) {
+        fprintf(stderr, "ema-sort-int: cannot create '%s': %s\n", path, strerror(errno));
+    } else {
+        unlink(path);
+    }
+    free(path);
+    return status;
+}
+
+static int merge_passes(SortIo* io, IoFile* spills, off_t* starts, size_t runs, IoFile* output,
+                        const char* output_path, const SortOptions* options, SortStats* stats) {
+    size_t fan_in = stats->fan_in;
+    char* arena = io_alloc((fan_in + 1) * (size_t)io->slots * io->buffer_size);
+    if (!arena) {
+        fprintf(stderr, "ema-sort-int: memory allocation failed for merge buffers\n");
+        return -1;
+    }
+
+    int status = 0;
+    int source = 0;
+    while (status == 0 && runs > fan_in) {
+        int target = 1 - source;
+        if (spills[target].fd < 0) {
+            status = open_spill(&spills[target], output_path, target, options->engine);
+        }
+        size_t merged = 0;
+        for (size_t first = 0; first < runs && status == 0; first += fan_in) {
+            size_t group = runs - first < fan_in ? runs - first : fan_in;
+            status = merge_group(io, arena, &spills[source], starts + first, group, &spills[target], starts[first]);
+            starts[merged++] = starts[first];
+        }
+        starts[merged] = starts[runs];
+        runs = merged;
+        source = target;
+        stats->passes++;
+    }
+    if (status == 0) {
+        status = merge_group(io, arena, &spills[source], starts, runs, output, 0);
+        stats->passes++;
+    }
+
+    free(arena);
+    return status;
+}
+
+int sort_file(const char* input_path, const char* output_path, const SortOptions* options, SortStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    size_t memory_limit = options->memory_limit ? options->memory_limit : SORT_DEFAULT_MEMORY_LIMIT;
+
+    IoFile input;
+    uint64_t count;
+    if (open_values(&input, input_path, options, &count) != 0) {
+        return -1;
+    }
+    IoFile output;
+    if (io_file_open(&output, output_path, O_RDWR | O_CREAT | O_TRUNC, options->engine) != 0) {
+        fprintf(stderr, "ema-sort-int: cannot create '%s': %s\n", output_path, strerror(errno));
+        io_file_close(&input);
+        return -1;
+    }
+
+    /* Run formation holds the run and the radix scratch copy, in whole pages. */
+    size_t capacity = memory_limit / 2 / sizeof(int64_t) / VALUES_PER_PAGE * VALUES_PER_PAGE;
+    if (capacity == 0) {
+        capacity = VALUES_PER_PAGE;
+    }
+    stats->count = count;
+    stats->runs = (size_t)((count + capacity - 1) / capacity);
+
+    IoQueue queue;
+    SortIo io = {&queue, buffer_bytes(options), options->double_buffer ? 2 : 1};
+    size_t fan_in = memory_limit / ((size_t)io.slots * io.buffer_size);
+    stats->fan_in = fan_in > MIN_FAN_IN + 1 ? fan_in - 1 : MIN_FAN_IN;
+
+    IoFile spills[2] = {{-1, options->engine}, {-1, options->engine}};
+    int status = 0;
+    if (stats->runs <= 1) {
+        status = form_runs(&input, &output, count, capacity, stats);
+    } else {
+        off_t* starts = malloc((stats->runs + 1) * sizeof(off_t));
+        status = starts ? open_spill(&spills[0], output_path, 0, options->engine) : -1;
+        if (status == 0) {
+            status = form_runs(&input, &spills[0], count, capacity, stats);
+        }
+        if (status == 0) {
+            for (size_t r = 0; r <= stats->runs; r++) {
+                uint64_t first = r < stats->runs ? (uint64_t)r * capacity : count;
+                starts[r] = (off_t)(first * sizeof(int64_t));
+            }
+            io_start(&queue, options->double_buffer);
+            status = merge_passes(&io, spills, starts, stats->runs, &output, output_path, options, stats);
+            io_stop(&queue);
+        }
+        free(starts);
+    }
+
+    io_file_close(&spills[0]);
+    io_file_close(&spills[1]);
+    io_file_close(&input);
+    if (io_file_close(&output) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+int sort_verify(const char* path, const SortOptions* options, SortStats* stats, bool* sorted) {
+    memset(stats, 0, sizeof(*stats));
+    *sorted = true;
+
+    IoFile file;
+    uint64_t count;
+    if (open_values(&file, path, options, &count) != 0) {
+        return -1;
+    }
+
+    IoQueue queue;
+    SortIo io = {&queue, buffer_bytes(options), options->double_buffer ? 2 : 1};
+    char* arena = io_alloc((size_t)io.slots * io.buffer_size);
+    int status = 0;
+    if (!arena) {
+        fprintf(stderr, "ema-sort-int: memory allocation failed\n");
+        status = -1;
+    } else {
+        io_start(&queue, options->double_buffer);
+        RunCursor cursor;
+        requests_reset(cursor.requests);
+        for (int slot = 0; slot < io.slots; slot++) {
+            cursor.buffers[slot] = (int64_t*)(arena + (size_t)slot * io.buffer_size);
+        }
+        int64_t previous = INT64_MIN;
+        bool more = cursor_start(&io, &cursor, &file, 0, (off_t)(count * sizeof(int64_t)));
+        while (more) {
+            const int64_t* values = cursor.buffers[cursor.slot];
+            for (size_t i = 0; i < cursor.length; i++) {
+                if (values[i] < previous) {
+                    *sorted = false;
+                }
+                previous = values[i];
+                stats->checksum += mix64((uint64_t)values[i]);
+            }
+            stats->count += cursor.length;
+            more = cursor_advance(&io, &cursor);
+        }
+        cursor_drain(&io, &cursor);
+        io_stop(&queue);
+        if (cursor.failed) {
+            fprintf(stderr, "ema-sort-int: reading '%s' failed\n", path);
+            status = -1;
+        }
+    }
+
+    free(arena);
+    io_file_close(&file);
+    return status;
+}
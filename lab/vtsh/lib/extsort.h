@@ -0,0 +1,44 @@
+#ifndef EXTSORT_H
+#define EXTSORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fileio.h"
+
+#define SORT_DEFAULT_MEMORY_LIMIT (64UL * 1024 * 1024)
+#define SORT_DEFAULT_BUFFER_SIZE (1024UL * 1024)
+
+typedef struct {
+    size_t memory_limit;
+    size_t buffer_size;
+    bool double_buffer;
+    IoEngine engine;
+} SortOptions;
+
+typedef struct {
+    uint64_t count;
+    uint64_t checksum;
+    size_t runs;
+    size_t passes;
+    size_t fan_in;
+} SortStats;
+
+/* Writes count pseudo-random int64 values in host byte order. */
+int sort_generate(const char* path, uint64_t count, uint64_t seed, const SortOptions* options);
+
+/*
+ * External merge sort of a file of int64 values. Runs of memory_limit / 2
+ * values are radix sorted in core, then merged through a loser tree with
+ * one buffer_size buffer per run (two with double_buffer, where a helper
+ * thread prefetches the next block of every run and writes the previous
+ * output block while the merge continues). Passes repeat until one merge
+ * can produce the output. stats->checksum is order independent, so it can
+ * be compared with sort_verify.
+ */
+int sort_file(const char* input, const char* output, const SortOptions* options, SortStats* stats);
+
+/* Checks that the file is non-decreasing; fills stats->count and stats->checksum. */
+int sort_verify(const char* path, const SortOptions* options, SortStats* stats, bool* sorted);
+
+#endif
@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include "factor.h"
+
+/* Trial division by the wheel stops here; anything left has no factor below it. */
+#define WHEEL_LIMIT 4096
+/* Rho iterations whose differences are multiplied together before one gcd. */
+#define RHO_BATCH 128
+
+typedef unsigned __int128 u128;
+
+/* Arithmetic modulo an odd n on Montgomery residues x * 2^64 mod n. */
+typedef struct {
+    uint64_t n;
+    uint64_t n_neg_inv;
+    uint64_t one;
+    uint64_t r2;
+} Montgomery;
+
+static void mont_init(Montgomery* m, uint64_t n) {
+    /* Newton iteration doubles the correct low bits of n^-1 each step. */
+    uint64_t inv = n;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - n * inv;
+    }
+    m->n = n;
+    m->n_neg_inv = 0 - inv;
+    m->one = (uint64_t)(((u128)1 << 64) % n);
+    m->r2 = (uint64_t)(((u128)m->one << 64) % n);
+}
+
+static uint64_t mont_reduce(const Montgomery* m, u128 t) {
+    uint64_t q = (uint64_t)t * m->n_neg_inv;
+    u128 sum = t + (u128)q * m->n;
+    /* t + q * n can exceed 2^128 by one carry, recovered from the wrap. */
+    uint64_t carry = sum < t;
+    uint64_t r = (uint64_t)(sum >> 64);
+    if (carry || r >= m->n) {
+        r -= m->n;
+    }
+    return r;
+}
+
+static uint64_t mont_mul(const Montgomery* m, uint64_t a, uint64_t b) {
+    return mont_reduce(m, (u128)a * b);
+}
+
+static uint64_t mont_to(const Montgomery* m, uint64_t a) {
+    return mont_mul(m, a % m->n, m->r2);
+}
+
+static uint64_t mont_add(const Montgomery* m, uint64_t a, uint64_t b) {
+    uint64_t s = a + b;
+    if (s < a || s >= m->n) {
+        s -= m->n;
+    }
+    return s;
+}
+
+static uint64_t mont_pow(const Montgomery* m, uint64_t base, uint64_t exponent) {
+    uint64_t result = m->one;
+    while (exponent > 0) {
+        if (exponent & 1) {
+            result = mont_mul(m, result, base);
+        }
+        base = mont_mul(m, base, base);
+        exponent >>= 1;
+    }
+    return result;
+}
+
+static uint64_t gcd_u64(uint64_t a, uint64_t b) {
+    if (a == 0) {
+        return b;
+    }
+    if (b == 0) {
+        return a;
+    }
+    int shift = __builtin_ctzll(a | b);
+    a >>= __builtin_ctzll(a);
+    while (b != 0) {
+        b >>= __builtin_ctzll(b);
+        if (a > b) {
+            uint64_t t = a;
+            a = b;
+            b = t;
+        }
+        b -= a;
+    }
+    return a << shift;
+}
+
+int factor_is_prime(uint64_t n) {
+    static const uint64_t small[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    if (n < 2) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(small) / sizeof(small[0]); i++) {
+        if (n % small[i] == 0) {
+            return n == small[i];
+        }
+    }
+    if (n < 37 * 37) {
+        return 1;
+    }
+
+    /* These seven bases are a proven witness set for all n < 2^64. */
+    static const uint64_t bases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+    Montgomery m;
+    mont_init(&m, n);
+    uint64_t d = n - 1;
+    int s = __builtin_ctzll(d);
+    d >>= s;
+    uint64_t minus_one = m.n - m.one;
+
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        uint64_t a = bases[i] % n;
+        if (a == 0) {
+            continue;
+        }
+        uint64_t x = mont_pow(&m, mont_to(&m, a), d);
+        if (x == m.one || x == minus_one) {
+            continue;
+        }
+        int composite = 1;
+        for (int r = 1; r < s && composite; r++) {
+            x = mont_mul(&m, x, x);
+            composite = x != minus_one;
+        }
+        if (composite) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Brent's cycle finding on x^2 + c, with gcds batched over RHO_BATCH steps. */
+static uint64_t pollard_brent(uint64_t n, uint64_t c) {
+    Montgomery m;
+    mont_init(&m, n);
+    uint64_t cm = mont_to(&m, c);
+    uint64_t y = mont_to(&m, 2);
+    uint64_t x = y, saved = y;
+    uint64_t q = m.one;
+    uint64_t g = 1;
+
+    for (uint64_t r = 1; g == 1; r <<= 1) {
+        x = y;
+        for (uint64_t i = 0; i < r; i++) {
+            y = mont_add(&m, mont_mul(&m, y, y), cm);
+        }
+        for (uint64_t k = 0; k < r && g == 1; k += RHO_BATCH) {
+            saved = y;
+            uint64_t steps = r - k < RHO_BATCH ? r - k : RHO_BATCH;
+            for (uint64_t i = 0; i < steps; i++) {
+                y = mont_add(&m, mont_mul(&m, y, y), cm);
+                q = mont_mul(&m, q, x > y ? x - y : y - x);
+            }
+            g = gcd_u64(q, n);
+        }
+    }
+
+    /* The batch overshot to a multiple of n; replay it one step at a time. */
+    if (g == n) {
+        do {
+            saved = mont_add(&m, mont_mul(&m, saved, saved), cm);
+            g = gcd_u64(x > saved ? x - saved : saved - x, n);
+        } while (g == 1);
+    }
+    return g;
+}
+
+static void split(uint64_t n, uint64_t* factors, int* count) {
+    if (n == 1) {
+        return;
+    }
+    if (factor_is_prime(n)) {
+        factors[(*count)++] = n;
+        return;
+    }
+    uint64_t divisor = n;
+    for (uint64_t c = 1; divisor == n; c++) {
+        divisor = pollard_brent(n, c);
+    }
+    split(divisor, factors, count);
+    split(n / divisor, factors, count);
+}
+
+static int compare_u64(const void* left, const void* right) {
+    uint64_t a = *(const uint64_t*)left;
+    uint64_t b = *(const uint64_t*)right;
+    return (a > b) - (a < b);
+}
+
+int factor_u64(uint64_t n, uint64_t factors[FACTOR_MAX]) {
+    static const uint64_t wheel_primes[] = {2, 3, 5};
+    /* Gaps between the residues coprime to 30, starting from 7. */
+    static const uint64_t wheel_gaps[] = {4, 2, 4, 2, 4, 6, 2, 6};
+    int count = 0;
+
+    for (size_t i = 0; i < sizeof(wheel_primes) / sizeof(wheel_primes[0]); i++) {
+        while (n % wheel_primes[i] == 0) {
+            factors[count++] = wheel_primes[i];
+            n /= wheel_primes[i];
+        }
+    }
+    size_t gap = 0;
+    for (uint64_t d = 7; d < WHEEL_LIMIT && d * d <= n; d += wheel_gaps[gap++ & 7]) {
+        while (n % d == 0) {
+            factors[count++] = d;
+            n /= d;
+        }
+    }
+
+    if (n > 1 && n < (uint64_t)WHEEL_LIMIT * WHEEL_LIMIT) {
+        /* No factor below WHEEL_LIMIT, so n itself is prime. */
+        factors[count++] = n;
+    } else {
+        split(n, factors, &count);
+    }
+
+    qsort(factors, (size_t)count, sizeof(uint64_t), compare_u64);
+    return count;
+}
@@ -0,0 +1,19 @@
+#ifndef FACTOR_H
+#define FACTOR_H
+
+#include <stdint.h>
+
+/* A 64-bit number has at most 64 prime factors counted with multiplicity. */
+#define FACTOR_MAX 64
+
+/* Deterministic Miller-Rabin, exact for every 64-bit n. */
+int factor_is_prime(uint64_t n);
+
+/*
+ * Writes the prime factors of n (n >= 2) to factors in ascending order and
+ * returns how many there are. Small primes are stripped with a mod-30
+ * wheel, the cofactor is split with Pollard-Brent rho in Montgomery form.
+ */
+int factor_u64(uint64_t n, uint64_t factors[FACTOR_MAX]);
+
+#endif
@@ -0,0 +1,186 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fileio.h"
+
+#ifdef VTSH_EMA_VTPC
+#include "vtpc.h"
+#endif
+
+int io_engine_available(IoEngine engine) {
+#ifdef VTSH_EMA_VTPC
+    return engine == IO_ENGINE_POSIX || engine == IO_ENGINE_VTPC ? 0 : -1;
+#else
+    return engine == IO_ENGINE_POSIX ? 0 : -1;
+#endif
+}
+
+int io_file_open(IoFile* file, const char* path, int flags, IoEngine engine) {
+    file->engine = engine;
+#ifdef VTSH_EMA_VTPC
+    if (engine == IO_ENGINE_VTPC) {
+        file->fd = vtpc_open(path, flags, 0644);
+        return file->fd < 0 ? -1 : 0;
+    }
+#endif
+    file->fd = open(path, flags, 0644);
+    return file->fd < 0 ? -1 : 0;
+}
+
+int io_file_close(IoFile* file) {
+    if (file->fd < 0) {
+        return 0;
+    }
+    int fd = file->fd;
+    file->fd = -1;
+#ifdef VTSH_EMA_VTPC
+    if (file->engine == IO_ENGINE_VTPC) {
+        return vtpc_close(fd);
+    }
+#endif
+    return close(fd);
+}
+
+off_t io_file_size(IoFile* file) {
+#ifdef VTSH_EMA_VTPC
+    if (file->engine == IO_ENGINE_VTPC) {
+        return vtpc_lseek(file->fd, 0, SEEK_END);
+    }
+#endif
+    struct stat st;
+    return fstat(file->fd, &st) == 0 ? st.st_size : -1;
+}
+
+/* vtpc has no pread, so it seeks first; that is safe because a file is only used by one thread at a time. */
+ssize_t io_file_transfer(IoFile* file, bool writing, void* buffer, size_t length, off_t offset) {
+#ifdef VTSH_EMA_VTPC
+    if (file->engine == IO_ENGINE_VTPC && vtpc_lseek(file->fd, offset, SEEK_SET) == (off_t)-1) {
+        return -1;
+    }
+#endif
+    size_t done = 0;
+    while (done < length) {
+        char* p = (char*)buffer + done;
+        ssize_t n;
+#ifdef VTSH_EMA_VTPC
+        if (file->engine == IO_ENGINE_VTPC) {
+            n = writing ? vtpc_write(file->fd, p, length - done) : vtpc_read(file->fd, p, length - done);
+        } else
+#endif
+        {
+            n = writing ? pwrite(file->fd, p, length - done, offset + (off_t)done)
+                        : pread(file->fd, p, length - done, offset + (off_t)done);
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += (size_t)n;
+    }
+    return (ssize_t)done;
+}
+
+static void* io_thread(void* arg) {
+    IoQueue* queue = arg;
+    pthread_mutex_lock(&queue->lock);
+    for (;;) {
+        while (!queue->head && !queue->stop) {
+            pthread_cond_wait(&queue->changed, &queue->lock);
+        }
+        IoRequest* request = queue->head;
+        if (!request) {
+            break;
+        }
+        queue->head = request->next;
+        if (!queue->head) {
+            queue->tail = NULL;
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        ssize_t result = io_file_transfer(request->file, request->writing, request->buffer, request->length,
+                                       request->offset);
+
+        pthread_mutex_lock(&queue->lock);
+        request->result = result;
+        request->done = true;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+void io_start(IoQueue* queue, bool threaded) {
+    memset(queue, 0, sizeof(*queue));
+    if (!threaded) {
+        return;
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    if (pthread_create(&queue->thread, NULL, io_thread, queue) != 0) {
+        fprintf(stderr, "cannot start I/O thread, falling back to synchronous I/O\n");
+        pthread_mutex_destroy(&queue->lock);
+        pthread_cond_destroy(&queue->changed);
+        return;
+    }
+    queue->running = true;
+}
+
+void io_stop(IoQueue* queue) {
+    if (!queue->running) {
+        return;
+    }
+    pthread_mutex_lock(&queue->lock);
+    queue->stop = true;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    pthread_join(queue->thread, NULL);
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+    queue->running = false;
+}
+
+void io_submit(IoQueue* queue, IoRequest* request) {
+    request->next = NULL;
+    if (!queue->running || request->length == 0) {
+        request->result = request->length == 0 ? 0
+                          : io_file_transfer(request->file, request->writing, request->buffer, request->length,
+                                          request->offset);
+        request->done = true;
+        return;
+    }
+    pthread_mutex_lock(&queue->lock);
+    request->done = false;
+    if (queue->tail) {
+        queue->tail->next = request;
+    } else {
+        queue->head = request;
+    }
+    queue->tail = request;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+int io_wait(IoQueue* queue, IoRequest* request) {
+    if (queue->running) {
+        pthread_mutex_lock(&queue->lock);
+        while (!request->done) {
+            pthread_cond_wait(&queue->changed, &queue->lock);
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
+    return request->result == (ssize_t)request->length ? 0 : -1;
+}
+
+void* io_alloc(size_t size) {
+    void* memory = NULL;
+    return posix_memalign(&memory, IO_ALIGNMENT, size) == 0 ? memory : NULL;
+}
@@ -0,0 +1,75 @@
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* I/O buffers are page aligned and sized in whole pages so they suit O_DIRECT and vtpc blocks. */
+#define IO_ALIGNMENT 4096
+
+/* Backend behind the ema-* file workloads: plain syscalls or the vtpc page cache. */
+typedef enum {
+    IO_ENGINE_POSIX,
+    IO_ENGINE_VTPC
+} IoEngine;
+
+typedef struct {
+    int fd;
+    IoEngine engine;
+} IoFile;
+
+/* Fails when the engine was not compiled in. */
+int io_engine_available(IoEngine engine);
+
+int io_file_open(IoFile* file, const char* path, int flags, IoEngine engine);
+int io_file_close(IoFile* file);
+off_t io_file_size(IoFile* file);
+
+/*
+ * Moves length bytes at offset, retrying short transfers; a read stops
+ * early only at end of file. Returns the byte count or -1. A file must not
+ * be used by two threads at once.
+ */
+ssize_t io_file_transfer(IoFile* file, bool writing, void* buffer, size_t length, off_t offset);
+
+/* IO_ALIGNMENT aligned allocation, released with free(). */
+void* io_alloc(size_t size);
+
+typedef struct IoRequest {
+    IoFile* file;
+    bool writing;
+    void* buffer;
+    size_t length;
+    off_t offset;
+    ssize_t result;
+    bool done;
+    struct IoRequest* next;
+} IoRequest;
+
+/*
+ * FIFO of transfers served by one helper thread. Without the thread every
+ * request is carried out synchronously on submit, so callers need no
+ * second code path for the unbuffered case. While the thread runs it is
+ * the only one touching the files it was handed.
+ */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    IoRequest* head;
+    IoRequest* tail;
+    bool running;
+    bool stop;
+} IoQueue;
+
+/* Falls back to synchronous I/O when the helper thread cannot be started. */
+void io_start(IoQueue* queue, bool threaded);
+void io_stop(IoQueue* queue);
+void io_submit(IoQueue* queue, IoRequest* request);
+
+/* Returns 0 once the request finished and moved every byte it asked for. */
+int io_wait(IoQueue* queue, IoRequest* request);
+
+#endif
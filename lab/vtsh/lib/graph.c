@@ -0,0 +1,486 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "graph.h"
+
+#define GRAPH_WRITE_BUFFER (1024 * 1024)
+/* A BFS batch ends at this many bytes of reads or nodes, whichever comes first. */
+#define GRAPH_BATCH_BYTES (1024 * 1024)
+#define GRAPH_BATCH_NODES 4096
+/* Records at most this far apart are fetched by one read that includes the gap. */
+#define GRAPH_COALESCE_GAP 4096
+
+/* xorshift64*: plenty for edge endpoints, and reproducible from the seed. */
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static uint32_t pick_neighbor(uint64_t* state, uint64_t id, uint64_t count, const GraphGenOptions* options) {
+    if (count == 1) {
+        return 0;
+    }
+    uint64_t after = count - 1 - id;
+    uint64_t before = id;
+    if (options->span != 0) {
+        after = after < options->span ? after : options->span;
+        before = before < options->span ? before : options->span;
+    }
+    bool forward = next_random(state) % 100 < options->forward_percent;
+    if ((forward && after > 0) || before == 0) {
+        return (uint32_t)(id + 1 + next_random(state) % after);
+    }
+    return (uint32_t)(id - 1 - next_random(state) % before);
+}
+
+int graph_generate(const char* path, uint64_t count, const GraphGenOptions* options) {
+    uint32_t degree = options->degree;
+    if (degree == 0 || degree > GRAPH_MAX_DEGREE || count == 0 || count > (uint64_t)UINT32_MAX + 1 ||
+        options->forward_percent > 100) {
+        fprintf(stderr, "ema-traverse-graph: invalid graph shape\n");
+        return -1;
+    }
+
+    IoFile file;
+    if (io_file_open(&file, path, O_WRONLY | O_CREAT | O_TRUNC, options->engine) != 0) {
+        fprintf(stderr, "ema-traverse-graph: cannot create '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    size_t node_size = GRAPH_NODE_SIZE(degree);
+    size_t per_buffer = GRAPH_WRITE_BUFFER / node_size;
+    char* buffer = io_alloc(per_buffer * node_size);
+    GraphHeader header = {{0}, GRAPH_VERSION, degree, 0, count};
+    memcpy(header.magic, GRAPH_MAGIC, sizeof(header.magic));
+
+    int status = 0;
+    if (!buffer) {
+        fprintf(stderr, "ema-traverse-graph: memory allocation failed\n");
+        status = -1;
+    } else if (io_file_transfer(&file, true, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+        status = -1;
+    }
+
+    uint64_t state = options->seed ^ 0x9E3779B97F4A7C15ULL;
+    if (state == 0) {
+        state = 1;
+    }
+    int32_t value_range = count < INT32_MAX ? (int32_t)count : INT32_MAX;
+    for (uint64_t first = 0; first < count && status == 0; first += per_buffer) {
+        size_t nodes = count - first < per_buffer ? (size_t)(count - first) : per_buffer;
+        for (size_t i = 0; i < nodes; i++) {
+            Node* node = (Node*)(buffer + i * node_size);
+            node->value = (int32_t)(next_random(&state) % (uint64_t)value_range);
+            for (uint32_t e = 0; e < degree; e++) {
+                node->neighbors[e] = pick_neighbor(&state, first + i, count, options);
+            }
+        }
+        size_t bytes = nodes * node_size;
+        if (io_file_transfer(&file, true, buffer, bytes, (off_t)graph_node_offset(degree, first)) != (ssize_t)bytes) {
+            status = -1;
+        }
+    }
+    if (buffer && status != 0) {
+        fprintf(stderr, "ema-traverse-graph: writing '%s' failed\n", path);
+    }
+
+    free(buffer);
+    if (io_file_close(&file) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+typedef struct {
+    uint32_t* ids;
+    size_t count;
+    size_t capacity;
+} IdList;
+
+static int id_list_push(IdList* list, uint32_t id) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        uint32_t* ids = realloc(list->ids, capacity * sizeof(uint32_t));
+        if (!ids) {
+            return -1;
+        }
+        list->ids = ids;
+        list->capacity = capacity;
+    }
+    list->ids[list->count++] = id;
+    return 0;
+}
+
+static int compare_u32(const void* left, const void* right) {
+    uint32_t a = *(const uint32_t*)left;
+    uint32_t b = *(const uint32_t*)right;
+    return (a > b) - (a < b);
+}
+
+typedef struct {
+    IoFile file;
+    IoQueue queue;
+    uint32_t degree;
+    size_t node_size;
+    uint64_t count;
+    uint64_t* visited;
+    int32_t value;
+    const GraphSearchOptions* options;
+    GraphSearchResult* result;
+} GraphSearch;
+
+/* Marks id as seen and reports whether it was new. */
+static bool visit(GraphSearch* search, uint32_t id) {
+    uint64_t bit = (uint64_t)1 << (id & 63);
+    uint64_t* word = &search->visited[id >> 6];
+    if (*word & bit) {
+        return false;
+    }
+    *word |= bit;
+    return true;
+}
+
+static bool node_matches(GraphSearch* search, const Node* node, uint32_t id, uint32_t depth) {
+    search->result->visited++;
+    if (node->value != search->value) {
+        return false;
+    }
+    search->result->found = true;
+    search->result->node = id;
+    search->result->depth = depth;
+    return true;
+}
+
+static void submit_read(GraphSearch* search, IoRequest* request) {
+    search->result->reads++;
+    search->result->bytes += request->length;
+    io_submit(&search->queue, request);
+}
+
+/* One slice of a sorted frontier; node i lives at buffer + positions[i] once read extents[i] is done. */
+typedef struct {
+    char* buffer;
+    IoRequest* requests;
+    size_t* positions;
+    size_t* extents;
+    const uint32_t* ids;
+    size_t count;
+    size_t request_count;
+} GraphBatch;
+
+static void batch_free(GraphBatch* batch) {
+    free(batch->buffer);
+    free(batch->requests);
+    free(batch->positions);
+    free(batch->extents);
+}
+
+static int batch_alloc(GraphBatch* batch) {
+    memset(batch, 0, sizeof(*batch));
+    batch->buffer = io_alloc(GRAPH_BATCH_BYTES);
+    batch->requests = calloc(GRAPH_BATCH_NODES, sizeof(IoRequest));
+    batch->positions = malloc(GRAPH_BATCH_NODES * sizeof(size_t));
+    batch->extents = malloc(GRAPH_BATCH_NODES * sizeof(size_t));
+    if (!batch->buffer || !batch->requests || !batch->positions || !batch->extents) {
+        batch_free(batch);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Takes ids from the front of a sorted frontier until the batch is full.
+ * Neighboring records are merged into one extent and every extent becomes
+ * one read, queued in ascending offset order. Returns the ids taken.
+ */
+static size_t batch_fill(GraphSearch* search, GraphBatch* batch, const uint32_t* ids, size_t available) {
+    IoRequest* extent = NULL;
+    size_t used = 0;
+    batch->ids = ids;
+    batch->count = 0;
+    batch->request_count = 0;
+
+    while (batch->count < available && batch->count < GRAPH_BATCH_NODES) {
+        off_t offset = (off_t)graph_node_offset(search->degree, ids[batch->count]);
+        off_t extent_end = extent ? extent->offset + (off_t)extent->length : 0;
+        size_t grow = extent ? (size_t)(offset - extent_end) + search->node_size : 0;
+        if (extent && offset - extent_end <= GRAPH_COALESCE_GAP && used + grow <= GRAPH_BATCH_BYTES) {
+            extent->length += grow;
+            used += grow;
+        } else {
+            if (used + search->node_size > GRAPH_BATCH_BYTES) {
+                break;
+            }
+            extent = &batch->requests[batch->request_count++];
+            extent->file = &search->file;
+            extent->writing = false;
+            extent->buffer = batch->buffer + used;
+            extent->length = search->node_size;
+            extent->offset = offset;
+            used += search->node_size;
+        }
+        batch->positions[batch->count] = (size_t)((char*)extent->buffer - batch->buffer) + (size_t)(offset - extent->offset);
+        batch->extents[batch->count] = batch->request_count - 1;
+        batch->count++;
+    }
+
+    for (size_t r = 0; r < batch->request_count; r++) {
+        submit_read(search, &batch->requests[r]);
+    }
+    return batch->count;
+}
+
+static void batch_drain(GraphSearch* search, GraphBatch* batch) {
+    for (size_t r = 0; r < batch->request_count; r++) {
+        io_wait(&search->queue, &batch->requests[r]);
+    }
+    batch->request_count = 0;
+}
+
+/* Scans nodes as soon as their extent arrives and collects unseen neighbors into next. */
+static int batch_scan(GraphSearch* search, GraphBatch* batch, uint32_t depth, IdList* next) {
+    size_t arrived = 0;
+    bool expand = depth < search->options->depth;
+    for (size_t i = 0; i < batch->count; i++) {
+        for (; arrived <= batch->extents[i]; arrived++) {
+            if (io_wait(&search->queue, &batch->requests[arrived]) != 0) {
+                fprintf(stderr, "ema-traverse-graph: reading node %u failed\n", batch->ids[i]);
+                return -1;
+            }
+        }
+        const Node* node = (const Node*)(batch->buffer + batch->positions[i]);
+        if (node_matches(search, node, batch->ids[i], depth)) {
+            return 0;
+        }
+        for (uint32_t e = 0; expand && e < search->degree; e++) {
+            uint32_t id = node->neighbors[e];
+            if (id >= search->count) {
+                fprintf(stderr, "ema-traverse-graph: node %u has an edge to missing node %u\n", batch->ids[i], id);
+                return -1;
+            }
+            if (visit(search, id) && id_list_push(next, id) != 0) {
+                fprintf(stderr, "ema-traverse-graph: memory allocation failed for the frontier\n");
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int search_bfs(GraphSearch* search) {
+    IdList frontier = {0};
+    IdList next = {0};
+    GraphBatch batches[2];
+    bool prefetch = search->options->prefetch;
+    int status = 0;
+
+    if (batch_alloc(&batches[0]) != 0 || batch_alloc(&batches[1]) != 0 ||
+        id_list_push(&frontier, search->options->root) != 0) {
+        fprintf(stderr, "ema-traverse-graph: memory allocation failed\n");
+        status = -1;
+    }
+    visit(search, search->options->root);
+
+    for (uint32_t depth = 0; status == 0 && frontier.count > 0 && !search->result->found; depth++) {
+        search->result->levels = depth + 1;
+        qsort(frontier.ids, frontier.count, sizeof(uint32_t), compare_u32);
+        next.count = 0;
+
+        int current = 0;
+        size_t taken = batch_fill(search, &batches[current], frontier.ids, frontier.count);
+        while (batches[current].count > 0) {
+            GraphBatch* batch = &batches[current];
+            GraphBatch* ahead = &batches[1 - current];
+            ahead->count = 0;
+            if (prefetch) {
+                taken += batch_fill(search, ahead, frontier.ids + taken, frontier.count - taken);
+            }
+            status = batch_scan(search, batch, depth, &next);
+            batch_drain(search, batch);
+            if (status != 0 || search->result->found) {
+                batch_drain(search, ahead);
+                break;
+            }
+            if (!prefetch) {
+                taken += batch_fill(search, ahead, frontier.ids + taken, frontier.count - taken);
+            }
+            current = 1 - current;
+        }
+
+        IdList swap = frontier;
+        frontier = next;
+        next = swap;
+    }
+
+    batch_free(&batches[0]);
+    batch_free(&batches[1]);
+    free(frontier.ids);
+    free(next.ids);
+    return status;
+}
+
+typedef struct {
+    uint32_t id;
+    uint32_t depth;
+} StackEntry;
+
+static void node_request(GraphSearch* search, IoRequest* request, void* buffer, uint32_t id) {
+    request->file = &search->file;
+    request->writing = false;
+    request->buffer = buffer;
+    request->length = search->node_size;
+    request->offset = (off_t)graph_node_offset(search->degree, id);
+    submit_read(search, request);
+}
+
+/* With prefetch the node on top of the stack is read while the current one is expanded. */
+static int search_dfs(GraphSearch* search) {
+    size_t capacity = 1024;
+    size_t top = 0;
+    StackEntry* stack = malloc(capacity * sizeof(StackEntry));
+    char* buffers[2] = {io_alloc(search->node_size), io_alloc(search->node_size)};
+    IoRequest requests[2];
+    memset(requests, 0, sizeof(requests));
+    requests[0].done = requests[1].done = true;
+    int status = 0;
+    if (!stack || !buffers[0] || !buffers[1]) {
+        fprintf(stderr, "ema-traverse-graph: memory allocation failed\n");
+        status = -1;
+    } else {
+        visit(search, search->options->root);
+        stack[top++] = (StackEntry){search->options->root, 0};
+    }
+
+    int pending = -1;
+    uint32_t pending_id = 0;
+    while (status == 0 && top > 0) {
+        StackEntry entry = stack[--top];
+        int slot = pending;
+        if (pending < 0 || pending_id != entry.id) {
+            if (pending >= 0) {
+                io_wait(&search->queue, &requests[pending]);
+            }
+            slot = 0;
+            node_request(search, &requests[slot], buffers[slot], entry.id);
+        }
+        pending = -1;
+        if (io_wait(&search->queue, &requests[slot]) != 0) {
+            fprintf(stderr, "ema-traverse-graph: reading node %u failed\n", entry.id);
+            status = -1;
+            break;
+        }
+
+        const Node* node = (const Node*)buffers[slot];
+        if (entry.depth + 1 > search->result->levels) {
+            search->result->levels = entry.depth + 1;
+        }
+        if (node_matches(search, node, entry.id, entry.depth)) {
+            break;
+        }
+        /* Pushed in reverse so that neighbors are explored in stored order. */
+        for (uint32_t e = search->degree; entry.depth < search->options->depth && e > 0; e--) {
+            uint32_t id = node->neighbors[e - 1];
+            if (id >= search->count) {
+                fprintf(stderr, "ema-traverse-graph: node %u has an edge to missing node %u\n", entry.id, id);
+                status = -1;
+                break;
+            }
+            if (!visit(search, id)) {
+                continue;
+            }
+            if (top == capacity) {
+                StackEntry* grown = realloc(stack, capacity * 2 * sizeof(StackEntry));
+                if (!grown) {
+                    fprintf(stderr, "ema-traverse-graph: memory allocation failed for the stack\n");
+                    status = -1;
+                    break;
+                }
+                stack = grown;
+                capacity *= 2;
+            }
+            stack[top++] = (StackEntry){id, entry.depth + 1};
+        }
+        if (status == 0 && search->options->prefetch && top > 0) {
+            pending = 1 - slot;
+            pending_id = stack[top - 1].id;
+            node_request(search, &requests[pending], buffers[pending], pending_id);
+        }
+    }
+
+    io_wait(&search->queue, &requests[0]);
+    io_wait(&search->queue, &requests[1]);
+    free(stack);
+    free(buffers[0]);
+    free(buffers[1]);
+    return status;
+}
+
+static int read_header(GraphSearch* search, const char* path) {
+    GraphHeader header;
+    off_t size = io_file_size(&search->file);
+    if (io_file_transfer(&search->file, false, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, GRAPH_MAGIC, sizeof(header.magic)) != 0 || header.version != GRAPH_VERSION ||
+        header.degree == 0 || header.degree > GRAPH_MAX_DEGREE || header.count == 0 ||
+        header.count > (uint64_t)UINT32_MAX + 1 || size != (off_t)graph_node_offset(header.degree, header.count)) {
+        fprintf(stderr, "ema-traverse-graph: '%s' is not a graph file\n", path);
+        return -1;
+    }
+    search->degree = header.degree;
+    search->node_size = GRAPH_NODE_SIZE(header.degree);
+    search->count = header.count;
+    return 0;
+}
+
+int graph_search(const char* path, int32_t value, int32_t replacement, const GraphSearchOptions* options,
+                 GraphSearchResult* result) {
+    GraphSearch search;
+    memset(&search, 0, sizeof(search));
+    memset(result, 0, sizeof(*result));
+    search.value = value;
+    search.options = options;
+    search.result = result;
+
+    if (io_file_open(&search.file, path, O_RDWR, options->engine) != 0) {
+        fprintf(stderr, "ema-traverse-graph: cannot open '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    int status = read_header(&search, path);
+    if (status == 0 && options->root >= search.count) {
+        fprintf(stderr, "ema-traverse-graph: root %u is not in the graph\n", options->root);
+        status = -1;
+    }
+    if (status == 0) {
+        search.visited = calloc((search.count + 63) / 64, sizeof(uint64_t));
+        if (!search.visited) {
+            fprintf(stderr, "ema-traverse-graph: memory allocation failed for the visited set\n");
+            status = -1;
+        }
+    }
+
+    if (status == 0) {
+        io_start(&search.queue, options->prefetch);
+        status = options->order == GRAPH_BFS ? search_bfs(&search) : search_dfs(&search);
+        io_stop(&search.queue);
+    }
+
+    /* The helper thread is gone, so the update cannot race a prefetch on the same file. */
+    if (status == 0 && result->found) {
+        off_t offset = (off_t)graph_node_offset(search.degree, result->node) + (off_t)offsetof(Node, value);
+        if (io_file_transfer(&search.file, true, &replacement, sizeof(replacement), offset) !=
+            (ssize_t)sizeof(replacement)) {
+            fprintf(stderr, "ema-traverse-graph: updating node %u failed\n", result->node);
+            status = -1;
+        }
+    }
+
+    free(search.visited);
+    if (io_file_close(&search.file) != 0) {
+        status = -1;
+    }
+    return status;
+}
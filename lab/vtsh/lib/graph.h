@@ -0,0 +1,87 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fileio.h"
+
+/*
+ * Serialized k-regular graph: this header, then count Node records of
+ * GRAPH_NODE_SIZE(degree) bytes packed back to back, node i at
+ * graph_node_offset(i). Integers are stored in host byte order.
+ */
+#define GRAPH_MAGIC "VTGR"
+#define GRAPH_VERSION 1
+#define GRAPH_MAX_DEGREE 64
+#define GRAPH_UNLIMITED_DEPTH UINT32_MAX
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t degree;
+    uint32_t reserved;
+    uint64_t count;
+} GraphHeader;
+
+/* Every field is 32-bit, so a record has no padding whatever the degree. */
+typedef struct {
+    int32_t value;
+    uint32_t neighbors[];
+} Node;
+
+#define GRAPH_NODE_SIZE(degree) (sizeof(Node) + (size_t)(degree) * sizeof(uint32_t))
+
+typedef enum {
+    GRAPH_BFS,
+    GRAPH_DFS
+} GraphOrder;
+
+typedef struct {
+    uint32_t degree;
+    /* Share of edges that point to a higher node id, 0..100. */
+    unsigned forward_percent;
+    /* Neighbors are at most span ids away; 0 means anywhere in the graph. */
+    uint64_t span;
+    uint64_t seed;
+    IoEngine engine;
+} GraphGenOptions;
+
+typedef struct {
+    GraphOrder order;
+    uint32_t depth;
+    uint32_t root;
+    bool prefetch;
+    IoEngine engine;
+} GraphSearchOptions;
+
+typedef struct {
+    bool found;
+    uint32_t node;
+    uint32_t depth;
+    uint64_t visited;
+    uint32_t levels;
+    uint64_t reads;
+    uint64_t bytes;
+} GraphSearchResult;
+
+static inline uint64_t graph_node_offset(uint32_t degree, uint64_t id) {
+    return sizeof(GraphHeader) + id * GRAPH_NODE_SIZE(degree);
+}
+
+/* Node values are uniform in [0, count), so a search for a small value usually has several candidates. */
+int graph_generate(const char* path, uint64_t count, const GraphGenOptions* options);
+
+/*
+ * Depth-limited search from options->root for the first node holding
+ * value; that node's value is overwritten with replacement in the file.
+ * BFS reads each frontier in batches sorted by file offset, coalescing
+ * nearby records into one read; with prefetch a helper thread reads the
+ * next batch while the current one is scanned. DFS reads one node at a
+ * time and with prefetch fetches the next node on the stack early. Each
+ * node is expanded at most once, at the depth it was first reached.
+ */
+int graph_search(const char* path, int32_t value, int32_t replacement, const GraphSearchOptions* options,
+                 GraphSearchResult* result);
+
+#endif
@@ -0,0 +1,1006 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "join.h"
+#include "loser_tree.h"
+#include "pool.h"
+
+#define HASH_EMPTY -1
+#define HASH_MULTIPLIER 0x9E3779B1U
+#define OUTPUT_INITIAL_CAPACITY (64 * 1024)
+/* "<id> <word> <word>\n" with a 32-bit id never exceeds this. */
+#define OUTPUT_MAX_LINE 48
+/* The sort-merge join writes its result in blocks of at most this size. */
+#define MERGE_OUTPUT_SIZE (1024 * 1024)
+#define MIN_MERGE_ROWS 4096
+/* Build partitions are sized to stay resident in a typical L2. */
+#define RADIX_PARTITION_BYTES (256 * 1024)
+#define RADIX_MAX_BITS 14
+/* Parallel nested loop and hash probes cut their input into this many slices per thread. */
+#define JOIN_CHUNKS_PER_THREAD 4
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} OutputBuffer;
+
+static int output_reserve(OutputBuffer* buffer, size_t extra) {
+    if (buffer->length + extra <= buffer->capacity) {
+        return 0;
+    }
+    size_t capacity = buffer->capacity ? buffer->capacity : OUTPUT_INITIAL_CAPACITY;
+    while (capacity < buffer->length + extra) {
+        capacity *= 2;
+    }
+    char* data = realloc(buffer->data, capacity);
+    if (!data) {
+        return -1;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+/* Formats "<id> <left> <right>\n" into dst, which must hold OUTPUT_MAX_LINE bytes. */
+static size_t format_row(char* dst, int id, const char* left, const char* right) {
+    char digits[12];
+    size_t length = 0;
+    unsigned int value = id < 0 ? 0U - (unsigned int)id : (unsigned int)id;
+    do {
+        digits[length++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    char* out = dst;
+    if (id < 0) {
+        *out++ = '-';
+    }
+    while (length > 0) {
+        *out++ = digits[--length];
+    }
+    *out++ = ' ';
+    memcpy(out, left, JOIN_WORD_LENGTH);
+    out += JOIN_WORD_LENGTH;
+    *out++ = ' ';
+    memcpy(out, right, JOIN_WORD_LENGTH);
+    out += JOIN_WORD_LENGTH;
+    *out++ = '\n';
+    return (size_t)(out - dst);
+}
+
+static int output_row(OutputBuffer* buffer, int id, const char* left, const char* right) {
+    if (output_reserve(buffer, OUTPUT_MAX_LINE) != 0) {
+        return -1;
+    }
+    buffer->length += format_row(buffer->data + buffer->length, id, left, right);
+    return 0;
+}
+
+/* Output of one slice of a parallel join; slices are written back in order. */
+typedef struct {
+    OutputBuffer buffer;
+    long long count;
+    int status;
+} JoinChunk;
+
+static size_t chunk_count(int rows, int threads) {
+    size_t chunks = threads > 1 ? (size_t)threads * JOIN_CHUNKS_PER_THREAD : 1;
+    return chunks < (size_t)rows ? chunks : (rows > 0 ? (size_t)rows : 1);
+}
+
+static void chunk_bounds(int rows, size_t chunks, size_t index, int* begin, int* end) {
+    *begin = (int)((long long)rows * (long long)index / (long long)chunks);
+    *end = (int)((long long)rows * (long long)(index + 1) / (long long)chunks);
+}
+
+/* Writes the total count, then every chunk's rows, and releases the buffers. */
+static int write_chunks(FILE* output, JoinChunk* chunks, size_t count) {
+    long long total = 0;
+    int status = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += chunks[i].count;
+        if (chunks[i].status != 0) {
+            status = -1;
+        }
+    }
+    if (status == 0) {
+        fprintf(output, "%lld\n", total);
+        for (size_t i = 0; i < count; i++) {
+            if (chunks[i].buffer.length > 0) {
+                fwrite(chunks[i].buffer.data, 1, chunks[i].buffer.length, output);
+            }
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        free(chunks[i].buffer.data);
+    }
+    return status;
+}
+
+typedef struct {
+    const Table* table1;
+    const Table* table2;
+    size_t chunks;
+    JoinChunk* out;
+} NestedLoopJob;
+
+static void nested_loop_chunk(void* arg, size_t index) {
+    NestedLoopJob* job = arg;
+    JoinChunk* out = &job->out[index];
+    int begin, end;
+    chunk_bounds(job->table1->count, job->chunks, index, &begin, &end);
+
+    for (int i = begin; i < end && out->status == 0; i++) {
+        const Row* left = &job->table1->rows[i];
+        for (int j = 0; j < job->table2->count; j++) {
+            const Row* right = &job->table2->rows[j];
+            if (left->id != right->id) {
+                continue;
+            }
+            if (output_row(&out->buffer, left->id, left->word, right->word) != 0) {
+                fprintf(stderr, "Memory allocation failed for join output\n");
+                out->status = -1;
+                break;
+            }
+            out->count++;
+        }
+    }
+}
+
+int join_nested_loop(const Table* table1, const Table* table2, FILE* output, int threads) {
+    NestedLoopJob job = {table1, table2, chunk_count(table1->count, threads), NULL};
+    job.out = calloc(job.chunks, sizeof(JoinChunk));
+    if (!job.out) {
+        fprintf(stderr, "Memory allocation failed for join output\n");
+        return -1;
+    }
+
+    pool_parallel_for(job.chunks, threads, nested_loop_chunk, &job);
+    int status = write_chunks(output, job.out, job.chunks);
+    free(job.out);
+    return status;
+}
+
+static size_t hash_slot(int id, size_t mask) {
+    return (size_t)((uint32_t)id * HASH_MULTIPLIER) & mask;
+}
+
+static size_t hash_capacity(int count) {
+    size_t capacity = 1;
+    while (capacity < (size_t)count * 2) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+/*
+ * Open-addressing table over the distinct keys of the build side. Each slot
+ * points at the first row with that key and rows sharing a key are chained
+ * through next[], so duplicates cost no extra probing. slots must hold
+ * mask + 1 entries and next one per build row.
+ */
+static void hash_build(const Row* build, int build_count, int* slots, int* next, size_t mask) {
+    memset(slots, 0xFF, (mask + 1) * sizeof(int));
+
+    /*
+     * Inserting backwards keeps every chain in table order. Output follows the
+     * probe side, so it matches the nested loop only when table2 is the build
+     * side; with table1 as the build side rows come in table2 order.
+     */
+    for (int i = build_count - 1; i >= 0; i--) {
+        size_t slot = hash_slot(build[i].id, mask);
+        while (slots[slot] != HASH_EMPTY && build[slots[slot]].id != build[i].id) {
+            slot = (slot + 1) & mask;
+        }
+        next[i] = slots[slot];
+        slots[slot] = i;
+    }
+}
+
+static int hash_probe(const Row* build, const Row* probe, int probe_count, bool build_left,
+                      const int* slots, const int* next, size_t mask, JoinChunk* out) {
+    for (int i = 0; i < probe_count; i++) {
+        const Row* probe_row = &probe[i];
+        size_t slot = hash_slot(probe_row->id, mask);
+        while (slots[slot] != HASH_EMPTY && build[slots[slot]].id != probe_row->id) {
+            slot = (slot + 1) & mask;
+        }
+
+        for (int match = slots[slot]; match != HASH_EMPTY; match = next[match]) {
+            const Row* build_row = &build[match];
+            const char* left = build_left ? build_row->word : probe_row->word;
+            const char* right = build_left ? probe_row->word : build_row->word;
+            if (output_row(&out->buffer, probe_row->id, left, right) != 0) {
+                fprintf(stderr, "Memory allocation failed for join output\n");
+                out->status = -1;
+                return -1;
+            }
+            out->count++;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    const Table* build;
+    const Table* probe;
+    bool build_left;
+    const int* slots;
+    const int* next;
+    size_t mask;
+    size_t chunks;
+    JoinChunk* out;
+} HashProbeJob;
+
+/* The table is read-only once built, so probe slices run in parallel. */
+static void hash_probe_chunk(void* arg, size_t index) {
+    HashProbeJob* job = arg;
+    int begin, end;
+    chunk_bounds(job->probe->count, job->chunks, index, &begin, &end);
+    hash_probe(job->build->rows, job->probe->rows + begin, end - begin, job->build_left,
+               job->slots, job->next, job->mask, &job->out[index]);
+}
+
+int join_hash(const Table* table1, const Table* table2, FILE* output, int threads) {
+    HashProbeJob job;
+    job.build_left = table1->count < table2->count;
+    job.build = job.build_left ? table1 : table2;
+    job.probe = job.build_left ? table2 : table1;
+
+    size_t capacity = hash_capacity(job.build->count);
+    int* slots = malloc(capacity * sizeof(int));
+    int* next = malloc(((size_t)job.build->count + 1) * sizeof(int));
+    job.chunks = chunk_count(job.probe->count, threads);
+    job.out = calloc(job.chunks, sizeof(JoinChunk));
+    if (!slots || !next || !job.out) {
+        fprintf(stderr, "Memory allocation failed for hash table\n");
+        free(slots);
+        free(next);
+        free(job.out);
+        return -1;
+    }
+
+    hash_build(job.build->rows, job.build->count, slots, next, capacity - 1);
+    job.slots = slots;
+    job.next = next;
+    job.mask = capacity - 1;
+    pool_parallel_for(job.chunks, threads, hash_probe_chunk, &job);
+    int status = write_chunks(output, job.out, job.chunks);
+
+    free(job.out);
+    free(slots);
+    free(next);
+    return status;
+}
+
+/*
+ * Radix-partitioned hash join. Both tables are scattered into 2^bits
+ * partitions by the top bits of the key hash so that every build partition
+ * fits in cache, then partitions are joined independently. Each phase runs
+ * on all threads: a histogram over each thread's slice, a prefix sum that
+ * gives every thread private write cursors, a scatter without any locking,
+ * and a join phase where threads claim partitions from a shared counter.
+ */
+typedef struct RadixJoin RadixJoin;
+
+typedef struct {
+    RadixJoin* join;
+    int id;
+    size_t* build_cursor;
+    size_t* probe_cursor;
+    int* slots;
+    size_t slots_capacity;
+    int* next;
+    size_t next_capacity;
+    JoinChunk* out;
+} RadixWorker;
+
+struct RadixJoin {
+    const Table* build;
+    const Table* probe;
+    bool build_left;
+    int bits;
+    size_t partitions;
+    int threads;
+    Row* build_rows;
+    Row* probe_rows;
+    size_t* build_offsets;
+    size_t* probe_offsets;
+    atomic_size_t next_partition;
+    RadixWorker* workers;
+    JoinChunk* out;
+};
+
+static size_t radix_partition(int id, int bits) {
+    return bits == 0 ? 0 : (size_t)(((uint32_t)id * HASH_MULTIPLIER) >> (32 - bits));
+}
+
+static void radix_slice(const Table* table, const RadixWorker* worker, int* begin, int* end) {
+    int threads = worker->join->threads;
+    *begin = (int)((long long)table->count * worker->id / threads);
+    *end = (int)((long long)table->count * (worker->id + 1) / threads);
+}
+
+static void radix_histogram(void* arg, size_t index) {
+    RadixJoin* join = arg;
+    RadixWorker* worker = &join->workers[index];
+    int begin, end;
+
+    radix_slice(join->build, worker, &begin, &end);
+    for (int i = begin; i < end; i++) {
+        worker->build_cursor[radix_partition(join->build->rows[i].id, join->bits)]++;
+    }
+    radix_slice(join->probe, worker, &begin, &end);
+    for (int i = begin; i < end; i++) {
+        worker->probe_cursor[radix_partition(join->probe->rows[i].id, join->bits)]++;
+    }
+}
+
+/* Turns per-thread counts into per-thread write positions, partition-major. */
+static void radix_prefix_sum(RadixJoin* join) {
+    size_t build_offset = 0;
+    size_t probe_offset = 0;
+    for (size_t p = 0; p < join->partitions; p++) {
+        join->build_offsets[p] = build_offset;
+        join->probe_offsets[p] = probe_offset;
+        for (int t = 0; t < join->threads; t++) {
+            RadixWorker* worker = &join->workers[t];
+            size_t build_count = worker->build_cursor[p];
+            size_t probe_count = worker->probe_cursor[p];
+            worker->build_cursor[p] = build_offset;
+            worker->probe_cursor[p] = probe_offset;
+            build_offset += build_count;
+            probe_offset += probe_count;
+        }
+    }
+    join->build_offsets[join->partitions] = build_offset;
+    join->probe_offsets[join->partitions] = probe_offset;
+}
+
+static void radix_scatter(void* arg, size_t index) {
+    RadixJoin* join = arg;
+    RadixWorker* worker = &join->workers[index];
+    int begin, end;
+
+    radix_slice(join->build, worker, &begin, &end);
+    for (int i = begin; i < end; i++) {
+        const Row* row = &join->build->rows[i];
+        join->build_rows[worker->build_cursor[radix_partition(row->id, join->bits)]++] = *row;
+    }
+    radix_slice(join->probe, worker, &begin, &end);
+    for (int i = begin; i < end; i++) {
+        const Row* row = &join->probe->rows[i];
+        join->probe_rows[worker->probe_cursor[radix_partition(row->id, join->bits)]++] = *row;
+    }
+}
+
+static int radix_reserve(RadixWorker* worker, int build_count) {
+    size_t capacity = hash_capacity(build_count);
+    if (capacity > worker->slots_capacity) {
+        int* slots = realloc(worker->slots, capacity * sizeof(int));
+        if (!slots) {
+            return -1;
+        }
+        worker->slots = slots;
+        worker->slots_capacity = capacity;
+    }
+    if ((size_t)build_count + 1 > worker->next_capacity) {
+        int* next = realloc(worker->next, ((size_t)build_count + 1) * sizeof(int));
+        if (!next) {
+            return -1;
+        }
+        worker->next = next;
+        worker->next_capacity = (size_t)build_count + 1;
+    }
+    return 0;
+}
+
+static void radix_join_partitions(void* arg, size_t index) {
+    RadixJoin* join = arg;
+    RadixWorker* worker = &join->workers[index];
+
+    while (worker->out->status == 0) {
+        size_t p = atomic_fetch_add(&join->next_partition, 1);
+        if (p >= join->partitions) {
+            break;
+        }
+
+        int build_count = (int)(join->build_offsets[p + 1] - join->build_offsets[p]);
+        int probe_count = (int)(join->probe_offsets[p + 1] - join->probe_offsets[p]);
+        if (build_count == 0 || probe_count == 0) {
+            continue;
+        }
+        if (radix_reserve(worker, build_count) != 0) {
+            fprintf(stderr, "Memory allocation failed for hash table\n");
+            worker->out->status = -1;
+            break;
+        }
+        const Row* build = join->build_rows + join->build_offsets[p];
+        size_t mask = hash_capacity(build_count) - 1;
+        hash_build(build, build_count, worker->slots, worker->next, mask);
+        hash_probe(build, join->probe_rows + join->probe_offsets[p], probe_count, join->build_left,
+                   worker->slots, worker->next, mask, worker->out);
+    }
+}
+
+static int radix_bits(int build_count, int threads) {
+    size_t target = RADIX_PARTITION_BYTES / sizeof(Row);
+    int bits = 0;
+    while (bits < RADIX_MAX_BITS && ((size_t)build_count >> bits) > target) {
+        bits++;
+    }
+    /* Enough partitions for the join phase to balance across threads. */
+    while (bits < RADIX_MAX_BITS && threads > 1 && ((size_t)1 << bits) < (size_t)threads * 4) {
+        bits++;
+    }
+    return bits;
+}
+
+int join_radix(const Table* table1, const Table* table2, FILE* output, int threads) {
+    RadixJoin join = {0};
+    join.build_left = table1->count < table2->count;
+    join.build = join.build_left ? table1 : table2;
+    join.probe = join.build_left ? table2 : table1;
+    join.threads = threads > 0 ? threads : 1;
+    join.bits = radix_bits(join.build->count, join.threads);
+    join.partitions = (size_t)1 << join.bits;
+    atomic_init(&join.next_partition, 0);
+
+    join.build_rows = malloc((size_t)join.build->count * sizeof(Row) + 1);
+    join.probe_rows = malloc((size_t)join.probe->count * sizeof(Row) + 1);
+    join.build_offsets = malloc((join.partitions + 1) * sizeof(size_t));
+    join.probe_offsets = malloc((join.partitions + 1) * sizeof(size_t));
+    join.workers = calloc((size_t)join.threads, sizeof(RadixWorker));
+    join.out = calloc((size_t)join.threads, sizeof(JoinChunk));
+    int status = 0;
+    if (!join.build_rows || !join.probe_rows || !join.build_offsets || !join.probe_offsets || !join.workers ||
+        !join.out) {
+        status = -1;
+    }
+    for (int t = 0; t < join.threads && status == 0; t++) {
+        RadixWorker* worker = &join.workers[t];
+        worker->join = &join;
+        worker->id = t;
+        worker->out = &join.out[t];
+        worker->build_cursor = calloc(join.partitions, sizeof(size_t));
+        worker->probe_cursor = calloc(join.partitions, sizeof(size_t));
+        if (!worker->build_cursor || !worker->probe_cursor) {
+            status = -1;
+        }
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "Memory allocation failed for radix partitions\n");
+    } else {
+        size_t workers = (size_t)join.threads;
+        pool_parallel_for(workers, join.threads, radix_histogram, &join);
+        radix_prefix_sum(&join);
+        pool_parallel_for(workers, join.threads, radix_scatter, &join);
+        pool_parallel_for(workers, join.threads, radix_join_partitions, &join);
+        status = write_chunks(output, join.out, workers);
+    }
+
+    for (int t = 0; join.workers && t < join.threads; t++) {
+        free(join.workers[t].build_cursor);
+        free(join.workers[t].probe_cursor);
+        free(join.workers[t].slots);
+        free(join.workers[t].next);
+    }
+    free(join.workers);
+    free(join.out);
+    free(join.build_rows);
+    free(join.probe_rows);
+    free(join.build_offsets);
+    free(join.probe_offsets);
+    return status;
+}
+
+typedef struct {
+    FILE** files;
+    size_t count;
+    size_t capacity;
+} RunList;
+
+typedef struct {
+    FILE* file;
+    TableReader* table;
+    Row* rows;
+    size_t capacity;
+    size_t length;
+    size_t position;
+} RunReader;
+
+typedef struct {
+    RunReader* readers;
+    int64_t* keys;
+    bool* done;
+    size_t count;
+    LoserTree tree;
+} MergeStream;
+
+static int compare_rows(const void* left, const void* right) {
+    const Row* a = left;
+    const Row* b = right;
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+static void runs_free(RunList* runs) {
+    for (size_t i = 0; i < runs->count; i++) {
+        if (runs->files[i]) {
+            fclose(runs->files[i]);
+        }
+    }
+    free(runs->files);
+    runs->files = NULL;
+    runs->count = 0;
+    runs->capacity = 0;
+}
+
+static int runs_push(RunList* runs, FILE* file) {
+    if (runs->count == runs->capacity) {
+        size_t capacity = runs->capacity ? runs->capacity * 2 : 8;
+        FILE** files = realloc(runs->files, capacity * sizeof(FILE*));
+        if (!files) {
+            return -1;
+        }
+        runs->files = files;
+        runs->capacity = capacity;
+    }
+    runs->files[runs->count++] = file;
+    return 0;
+}
+
+/*
+ * Spill files are anonymous and unbuffered: every fread and fwrite moves a
+ * whole block of the caller's buffer, and those count against the limit.
+ */
+static FILE* spill_open(void) {
+    FILE* file = tmpfile();
+    if (file) {
+        setvbuf(file, NULL, _IONBF, 0);
+    }
+    return file;
+}
+
+static int spill_rows(RunList* runs, const Row* rows, size_t count) {
+    FILE* file = spill_open();
+    if (!file) {
+        perror("ema-join-inner: tmpfile");
+        return -1;
+    }
+    if (fwrite(rows, sizeof(Row), count, file) != count || fflush(file) != 0 || runs_push(runs, file) != 0) {
+        perror("ema-join-inner: writing spill run");
+        fclose(file);
+        return -1;
+    }
+    rewind(file);
+    return 0;
+}
+
+/* Reads the table in memory-sized chunks and spills every chunk as a sorted run. */
+static int form_runs(TableReader* reader, size_t memory_limit, RunList* runs) {
+    int count = reader->count;
+
+    size_t capacity = memory_limit / sizeof(Row);
+    if (capacity == 0) {
+        capacity = 1;
+    }
+    if (capacity > (size_t)count) {
+        capacity = (size_t)count;
+    }
+
+    Row* rows = malloc(capacity * sizeof(Row) + 1);
+    if (!rows) {
+        fprintf(stderr, "Memory allocation failed for %s run buffer\n", reader->name);
+        return -1;
+    }
+
+    int status = 0;
+    size_t filled = 0;
+    for (int i = 0; i < count && status == 0; i++) {
+        if (table_reader_next(reader, &rows[filled]) != 0) {
+            status = -1;
+        } else if (++filled == capacity) {
+            qsort(rows, filled, sizeof(Row), compare_rows);
+            status = spill_rows(runs, rows, filled);
+            filled = 0;
+        }
+    }
+    if (status == 0 && filled > 0) {
+        qsort(rows, filled, sizeof(Row), compare_rows);
+        status = spill_rows(runs, rows, filled);
+    }
+
+    free(rows);
+    return status;
+}
+
+/* A run is either a spill file or a table that is already sorted by id. */
+static bool reader_fill(RunReader* reader) {
+    reader->position = 0;
+    if (reader->table) {
+        reader->length = 0;
+        while (reader->length < reader->capacity && reader->table->index < reader->table->count &&
+               table_reader_next(reader->table, &reader->rows[reader->length]) == 0) {
+            reader->length++;
+        }
+    } else {
+        reader->length = fread(reader->rows, sizeof(Row), reader->capacity, reader->file);
+    }
+    return reader->length > 0;
+}
+
+static void stream_free(MergeStream* stream) {
+    if (stream->readers) {
+        for (size_t i = 0; i < stream->count; i++) {
+            free(stream->readers[i].rows);
+        }
+    }
+    loser_tree_free(&stream->tree);
+    free(stream->readers);
+    free(stream->keys);
+    free(stream->done);
+    memset(stream, 0, sizeof(*stream));
+}
+
+/* Rows a run still holds: the rest of a table, or a whole spill file that was just rewound. */
+static size_t run_length(const RunReader* reader) {
+    if (reader->table) {
+        return (size_t)(reader->table->count - reader->table->index);
+    }
+    struct stat st;
+    return fstat(fileno(reader->file), &st) == 0 ? (size_t)st.st_size / sizeof(Row) : SIZE_MAX;
+}
+
+/* Each run gets a buffer of buffer_rows, or of its own length when it is shorter. */
+static int stream_open(MergeStream* stream, FILE** files, size_t count, TableReader* table, size_t buffer_rows) {
+    memset(stream, 0, sizeof(*stream));
+    stream->count = count;
+    stream->readers = calloc(count, sizeof(RunReader));
+    stream->keys = calloc(count + 1, sizeof(int64_t));
+    stream->done = calloc(count + 1, sizeof(bool));
+    if (!stream->readers || !stream->keys || !stream->done) {
+        stream_free(stream);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        RunReader* reader = &stream->readers[i];
+        reader->file = files ? files[i] : NULL;
+        reader->table = table;
+        size_t length = run_length(reader);
+        reader->capacity = length < buffer_rows ? (length > 0 ? length : 1) : buffer_rows;
+        reader->rows = malloc(reader->capacity * sizeof(Row));
+        if (!reader->rows) {
+            stream_free(stream);
+            return -1;
+        }
+        stream->done[i] = !reader_fill(reader);
+        stream->keys[i] = stream->done[i] ? 0 : reader->rows[0].id;
+    }
+
+    if (loser_tree_init(&stream->tree, count, stream->keys, stream->done) != 0) {
+        stream_free(stream);
+        return -1;
+    }
+    return 0;
+}
+
+static bool stream_next(MergeStream* stream, Row* row) {
+    if (stream->count == 0) {
+        return false;
+    }
+    size_t winner = loser_tree_winner(&stream->tree);
+    if (stream->done[winner]) {
+        return false;
+    }
+
+    RunReader* reader = &stream->readers[winner];
+    *row = reader->rows[reader->position++];
+    if (reader->position == reader->length && !reader_fill(reader)) {
+        stream->done[winner] = true;
+    } else {
+        stream->keys[winner] = reader->rows[reader->position].id;
+    }
+    loser_tree_replay(&stream->tree, winner);
+    return true;
+}
+
+static int write_rows(FILE* file, const Row* rows, size_t count) {
+    return count == 0 || fwrite(rows, sizeof(Row), count, file) == count ? 0 : -1;
+}
+
+/*
+ * Merges groups of at most fan_in runs into longer runs until no more than
+ * target are left. A pass holds fan_in read buffers and one write buffer
+ * of buffer_rows each.
+ */
+static int reduce_runs(RunList* runs, size_t target, size_t fan_in, size_t buffer_rows, size_t* passes) {
+    Row* pending = NULL;
+    if (runs->count > target && !(pending = malloc(buffer_rows * sizeof(Row)))) {
+        fprintf(stderr, "Memory allocation failed for merge output buffer\n");
+        return -1;
+    }
+    while (runs->count > target) {
+        (*passes)++;
+        RunList merged = {0};
+        for (size_t first = 0; first < runs->count; first += fan_in) {
+            size_t group = runs->count - first < fan_in ? runs->count - first : fan_in;
+            MergeStream stream;
+            FILE* file = spill_open();
+            if (!file || stream_open(&stream, runs->files + first, group, NULL, buffer_rows) != 0) {
+                fprintf(stderr, "ema-join-inner: cannot set up merge pass\n");
+                if (file) fclose(file);
+                runs_free(&merged);
+                free(pending);
+                return -1;
+            }
+
+            size_t filled = 0;
+            int status = 0;
+            while (status == 0 && stream_next(&stream, &pending[filled])) {
+                if (++filled == buffer_rows) {
+                    status = write_rows(file, pending, filled);
+                    filled = 0;
+                }
+            }
+            stream_free(&stream);
+            if (status != 0 || write_rows(file, pending, filled) != 0 || runs_push(&merged, file) != 0) {
+                perror("ema-join-inner: writing merged run");
+                fclose(file);
+                runs_free(&merged);
+                free(pending);
+                return -1;
+            }
+            rewind(file);
+
+            for (size_t i = first; i < first + group; i++) {
+                fclose(runs->files[i]);
+                runs->files[i] = NULL;
+            }
+        }
+        runs_free(runs);
+        *runs = merged;
+    }
+    free(pending);
+    return 0;
+}
+
+static int flush_output(OutputBuffer* buffer, FILE* file) {
+    if (buffer->length > 0 && fwrite(buffer->data, 1, buffer->length, file) != buffer->length) {
+        return -1;
+    }
+    buffer->length = 0;
+    return 0;
+}
+
+/* Result rows collect in a fixed buffer that is written out once it cannot take another line. */
+static int emit_row(OutputBuffer* buffer, FILE* rows_file, int id, const char* left, const char* right) {
+    if (buffer->capacity - buffer->length < OUTPUT_MAX_LINE && flush_output(buffer, rows_file) != 0) {
+        return -1;
+    }
+    buffer->length += format_row(buffer->data + buffer->length, id, left, right);
+    return 0;
+}
+
+static int emit_group(OutputBuffer* buffer, FILE* rows_file, const Row* left, const Row* group, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (emit_row(buffer, rows_file, left->id, left->word, group[i].word) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Merge join of two sorted streams. All right-hand rows of the current key are
+ * gathered first, then crossed with every left-hand row of that key, so
+ * duplicates on both sides produce the full product. The group grows to at
+ * most group_limit rows; a larger one is spilled and re-read for every
+ * matching left-hand row.
+ */
+static int merge_join(MergeStream* left, MergeStream* right, OutputBuffer* buffer, FILE* rows_file,
+                      size_t group_limit, long long* count) {
+    Row* group = NULL;
+    size_t group_capacity = 0;
+    Row left_row;
+    Row right_row;
+    bool has_left = stream_next(left, &left_row);
+    bool has_right = stream_next(right, &right_row);
+    int status = 0;
+
+    *count = 0;
+    while (has_left && has_right && status == 0) {
+        if (left_row.id < right_row.id) {
+            has_left = stream_next(left, &left_row);
+        } else if (left_row.id > right_row.id) {
+            has_right = stream_next(right, &right_row);
+        } else {
+            int key = left_row.id;
+            size_t group_size = 0;
+            long long group_total = 0;
+            FILE* overflow = NULL;
+            while (status == 0 && has_right && right_row.id == key) {
+                if (group_size == group_limit) {
+                    if ((!overflow && !(overflow = spill_open())) || write_rows(overflow, group, group_size) != 0) {
+                        perror("ema-join-inner: spilling duplicate key group");
+                        status = -1;
+                        break;
+                    }
+                    group_size = 0;
+                } else if (group_size == group_capacity) {
+                    size_t capacity = group_capacity ? group_capacity * 2 : 16;
+                    capacity = capacity < group_limit ? capacity : group_limit;
+                    Row* grown = realloc(group, capacity * sizeof(Row));
+                    if (!grown) {
+                        fprintf(stderr, "Memory allocation failed for duplicate key group\n");
+                        status = -1;
+                        break;
+                    }
+                    group = grown;
+                    group_capacity = capacity;
+                }
+                group[group_size++] = right_row;
+                group_total++;
+                has_right = stream_next(right, &right_row);
+            }
+            if (status == 0 && overflow && write_rows(overflow, group, group_size) != 0) {
+                perror("ema-join-inner: spilling duplicate key group");
+                status = -1;
+            }
+
+            while (status == 0 && has_left && left_row.id == key) {
+                if (overflow) {
+                    rewind(overflow);
+                    size_t length;
+                    while (status == 0 && (length = fread(group, sizeof(Row), group_capacity, overflow)) > 0) {
+                        status = emit_group(buffer, rows_file, &left_row, group, length);
+                    }
+                } else {
+                    status = emit_group(buffer, rows_file, &left_row, group, group_size);
+                }
+                *count += group_total;
+                has_left = stream_next(left, &left_row);
+            }
+            if (overflow) {
+                fclose(overflow);
+            }
+        }
+    }
+
+    free(group);
+    return status == 0 ? flush_output(buffer, rows_file) : status;
+}
+
+/* Reuses the result buffer, so copying needs no memory beyond the limit. */
+static int copy_file(FILE* source, FILE* target, OutputBuffer* buffer) {
+    size_t length;
+    while ((length = fread(buffer->data, 1, buffer->capacity, source)) > 0) {
+        if (fwrite(buffer->data, 1, length, target) != length) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int join_sort_merge(FILE* file1, FILE* file2, FILE* output, size_t memory_limit, JoinMergeStats* stats) {
+    RunList runs1 = {0};
+    RunList runs2 = {0};
+    MergeStream left;
+    MergeStream right;
+    TableReader table1;
+    TableReader table2;
+    FILE* rows_file = NULL;
+    OutputBuffer result = {NULL, 0, 0};
+    long long count = 0;
+    int status = 0;
+
+    memset(&left, 0, sizeof(left));
+    memset(&right, 0, sizeof(right));
+    memset(&table1, 0, sizeof(table1));
+    memset(&table2, 0, sizeof(table2));
+    memset(stats, 0, sizeof(*stats));
+
+    if (table_reader_open(&table1, file1, "table1") != 0 || table_reader_open(&table2, file2, "table2") != 0) {
+        status = -1;
+    }
+
+    /* Input that could not be mapped was read into memory and takes its share of the limit. */
+    size_t budget = memory_limit;
+    const TableReader* tables[] = {&table1, &table2};
+    for (size_t i = 0; i < 2; i++) {
+        if (tables[i]->mapped) {
+            stats->mapped_bytes += tables[i]->size;
+        } else {
+            budget = budget > tables[i]->size ? budget - tables[i]->size : 0;
+        }
+    }
+
+    /* Binary tables flagged as sorted are merged straight from the mapping. */
+    if (status == 0 && ((!table1.sorted && form_runs(&table1, budget, &runs1) != 0) ||
+                        (!table2.sorted && form_runs(&table2, budget, &runs2) != 0))) {
+        status = -1;
+    }
+    stats->runs = runs1.count + runs2.count;
+
+    /*
+     * Every open run needs a read buffer and every merge a write buffer. The
+     * budget is cut into slots of MIN_MERGE_ROWS while it affords four, else
+     * into four smaller ones. Reduction passes merge slots - 1 runs at a time
+     * until the final pass can hold every run plus the result buffer and the
+     * duplicate key group.
+     */
+    size_t budget_rows = budget / sizeof(Row);
+    size_t merge_rows = budget_rows / 4 < MIN_MERGE_ROWS ? budget_rows / 4 : MIN_MERGE_ROWS;
+    if (merge_rows == 0) {
+        merge_rows = 1;
+    }
+    size_t slots = budget_rows / merge_rows;
+    if (slots < 4) {
+        slots = 4;
+    }
+    size_t readers = slots - 2;
+    size_t target1 = table2.sorted ? readers - 1 : readers / 2;
+    size_t target2 = table1.sorted ? readers - 1 : readers - readers / 2;
+    if (status == 0 && (reduce_runs(&runs1, target1, slots - 1, merge_rows, &stats->merge_passes) != 0 ||
+                        reduce_runs(&runs2, target2, slots - 1, merge_rows, &stats->merge_passes) != 0)) {
+        status = -1;
+    }
+
+    /* The final pass shares the whole budget between the runs that are left, the result and the group. */
+    size_t total_runs = runs1.count + runs2.count + table1.sorted + table2.sorted;
+    size_t buffer_rows = budget_rows / (total_runs + 2);
+    if (buffer_rows == 0) {
+        buffer_rows = 1;
+    }
+    stats->buffer_rows = buffer_rows;
+    result.capacity = buffer_rows * sizeof(Row) < MERGE_OUTPUT_SIZE ? buffer_rows * sizeof(Row) : MERGE_OUTPUT_SIZE;
+    if (result.capacity < OUTPUT_MAX_LINE) {
+        result.capacity = OUTPUT_MAX_LINE;
+    }
+
+    if (status == 0) {
+        rows_file = spill_open();
+        result.data = malloc(result.capacity);
+        if (!rows_file || !result.data) {
+            perror("ema-join-inner: setting up the result file");
+            status = -1;
+        }
+    }
+    if (status == 0 &&
+        (stream_open(&left, runs1.files, table1.sorted ? 1 : runs1.count, table1.sorted ? &table1 : NULL,
+                     buffer_rows) != 0 ||
+         stream_open(&right, runs2.files, table2.sorted ? 1 : runs2.count, table2.sorted ? &table2 : NULL,
+                     buffer_rows) != 0)) {
+        fprintf(stderr, "Memory allocation failed for merge buffers\n");
+        status = -1;
+    }
+    if (status == 0 && merge_join(&left, &right, &result, rows_file, buffer_rows, &count) != 0) {
+        perror("ema-join-inner: writing join result");
+        status = -1;
+    }
+    if (status == 0) {
+        rewind(rows_file);
+        fprintf(output, "%lld\n", count);
+        if (copy_file(rows_file, output, &result) != 0) {
+            perror("ema-join-inner: writing output");
+            status = -1;
+        }
+    }
+
+    stream_free(&left);
+    stream_free(&right);
+    runs_free(&runs1);
+    runs_free(&runs2);
+    table_reader_close(&table1);
+    table_reader_close(&table2);
+    free(result.data);
+    if (rows_file) {
+        fclose(rows_file);
+    }
+    return status;
+}
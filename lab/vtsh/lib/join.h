@@ -0,0 +1,83 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define JOIN_WORD_LENGTH 8
+#define JOIN_DEFAULT_MEMORY_LIMIT (64UL * 1024 * 1024)
+
+typedef struct {
+    int id;
+    char word[JOIN_WORD_LENGTH + 1];
+} Row;
+
+typedef struct {
+    Row* rows;
+    int count;
+} Table;
+
+/*
+ * Columnar binary table: this header, then count int32 ids, then count
+ * fixed 8-byte words without terminators. TABLE_BINARY_SORTED marks rows
+ * ordered by id. Integers are stored in host byte order.
+ */
+#define TABLE_BINARY_MAGIC "VTBL"
+#define TABLE_BINARY_VERSION 1
+#define TABLE_BINARY_SORTED 0x1U
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t count;
+} TableHeader;
+
+/*
+ * Streaming reader over a text table ("<count>" then "<id> <word>" rows)
+ * or a binary one, told apart by the magic. Regular files are mmapped and
+ * parsed in place; anything else is read into memory first. Text errors
+ * are reported with the table name and row.
+ */
+typedef struct {
+    const char* data;
+    size_t size;
+    size_t pos;
+    bool mapped;
+    bool binary;
+    bool sorted;
+    const int32_t* ids;
+    const char* words;
+    const char* name;
+    int count;
+    int index;
+} TableReader;
+
+int table_reader_open(TableReader* reader, FILE* file, const char* name);
+int table_reader_next(TableReader* reader, Row* row);
+void table_reader_close(TableReader* reader);
+int table_load(FILE* file, const char* name, Table* table);
+int table_write_text(const Table* table, FILE* output);
+int table_write_binary(const Table* table, FILE* output, bool sorted);
+
+int join_nested_loop(const Table* table1, const Table* table2, FILE* output, int threads);
+int join_hash(const Table* table1, const Table* table2, FILE* output, int threads);
+int join_radix(const Table* table1, const Table* table2, FILE* output, int threads);
+/*
+ * What the sort-merge join did within its memory limit. Mapped input lives
+ * in the page cache and is not counted against the limit; input that had
+ * to be read into memory is.
+ */
+typedef struct {
+    size_t runs;
+    size_t merge_passes;
+    size_t buffer_rows;
+    size_t mapped_bytes;
+} JoinMergeStats;
+
+int join_sort_merge(FILE* file1, FILE* file2, FILE* output, size_t memory_limit, JoinMergeStats* stats);
+
+#endif
@@ -0,0 +1,89 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "linereader.h"
+
+int line_reader_open(LineReader* reader, int fd) {
+    reader->fd = fd;
+    reader->capacity = LINE_READER_BLOCK;
+    reader->buffer = malloc(reader->capacity);
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = false;
+    reader->seekable = lseek(fd, 0, SEEK_CUR) != (off_t)-1;
+    return reader->buffer ? 0 : -1;
+}
+
+/* Moves the partial line to the front, growing the buffer when it already fills it. */
+static int fill(LineReader* reader) {
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+    /* One byte always stays free for the terminator of an unfinished last line. */
+    if (reader->capacity - reader->end < 2) {
+        char* grown = realloc(reader->buffer, reader->capacity * 2);
+        if (!grown) {
+            return -1;
+        }
+        reader->buffer = grown;
+        reader->capacity *= 2;
+    }
+
+    ssize_t n;
+    do {
+        n = read(reader->fd, reader->buffer + reader->end, reader->capacity - reader->end - 1);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        reader->eof = true;
+        return n == 0 ? 0 : -1;
+    }
+    reader->end += (size_t)n;
+    return 0;
+}
+
+char* line_reader_next(LineReader* reader) {
+    size_t scanned = reader->start;
+    for (;;) {
+        char* newline = memchr(reader->buffer + scanned, '\n', reader->end - scanned);
+        if (newline) {
+            char* line = reader->buffer + reader->start;
+            *newline = '\0';
+            reader->start = (size_t)(newline - reader->buffer) + 1;
+            return line;
+        }
+        if (reader->eof) {
+            if (reader->start == reader->end) {
+                return NULL;
+            }
+            char* line = reader->buffer + reader->start;
+            reader->buffer[reader->end] = '\0';
+            reader->start = reader->end;
+            return line;
+        }
+
+        size_t offset = reader->end - reader->start;
+        if (fill(reader) != 0) {
+            return NULL;
+        }
+        scanned = reader->start + offset;
+    }
+}
+
+void line_reader_sync(LineReader* reader) {
+    if (!reader->seekable || reader->start == reader->end) {
+        return;
+    }
+    if (lseek(reader->fd, -(off_t)(reader->end - reader->start), SEEK_CUR) != (off_t)-1) {
+        reader->start = 0;
+        reader->end = 0;
+        reader->eof = false;
+    }
+}
+
+void line_reader_close(LineReader* reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LINE_READER_BLOCK (64 * 1024)
+
+/*
+ * Splits a file descriptor into lines, reading LINE_READER_BLOCK bytes at
+ * a time. The buffer grows as needed, so a line may be of any length.
+ */
+typedef struct {
+    int fd;
+    char* buffer;
+    size_t capacity;
+    size_t start;
+    size_t end;
+    bool eof;
+    bool seekable;
+} LineReader;
+
+int line_reader_open(LineReader* reader, int fd);
+
+/*
+ * Returns the next line without its newline, NUL-terminated inside the
+ * reader's buffer and valid until the next call, or NULL at end of input.
+ * A last line without a newline is returned as well.
+ */
+char* line_reader_next(LineReader* reader);
+
+/*
+ * Gives read-ahead back to the file so that a child inheriting the
+ * descriptor starts right after the current line. Only seekable input can
+ * be rewound; a pipe keeps what was already read.
+ */
+void line_reader_sync(LineReader* reader);
+
+void line_reader_close(LineReader* reader);
+
+#endif
@@ -0,0 +1,58 @@
+#include <stdlib.h>
+#include "loser_tree.h"
+
+/* Leaf k is a virtual minus infinity that only exists while the tree is being built. */
+static bool beats(const LoserTree* tree, size_t a, size_t b) {
+    if (a == tree->k) {
+        return true;
+    }
+    if (b == tree->k) {
+        return false;
+    }
+    if (tree->done[a] != tree->done[b]) {
+        return !tree->done[a];
+    }
+    if (tree->done[a] || tree->keys[a] == tree->keys[b]) {
+        return a < b;
+    }
+    return tree->keys[a] < tree->keys[b];
+}
+
+void loser_tree_replay(LoserTree* tree, size_t leaf) {
+    size_t winner = leaf;
+    for (size_t node = (leaf + tree->k) / 2; node > 0; node /= 2) {
+        if (beats(tree, tree->nodes[node], winner)) {
+            size_t loser = winner;
+            winner = tree->nodes[node];
+            tree->nodes[node] = loser;
+        }
+    }
+    tree->nodes[0] = winner;
+}
+
+int loser_tree_init(LoserTree* tree, size_t k, const int64_t* keys, const bool* done) {
+    tree->k = k;
+    tree->keys = keys;
+    tree->done = done;
+    tree->nodes = malloc((k + 1) * sizeof(size_t));
+    if (!tree->nodes) {
+        return -1;
+    }
+
+    for (size_t i = 0; i <= k; i++) {
+        tree->nodes[i] = k;
+    }
+    for (size_t i = k; i > 0; i--) {
+        loser_tree_replay(tree, i - 1);
+    }
+    return 0;
+}
+
+size_t loser_tree_winner(const LoserTree* tree) {
+    return tree->nodes[0];
+}
+
+void loser_tree_free(LoserTree* tree) {
+    free(tree->nodes);
+    tree->nodes = NULL;
+}
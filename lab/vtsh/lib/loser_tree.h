@@ -0,0 +1,26 @@
+#ifndef LOSER_TREE_H
+#define LOSER_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Tournament tree for k-way merging. Node 0 holds the current winner, the
+ * other nodes hold the loser of the match played there, so replacing the
+ * winner costs exactly log2(k) comparisons. Leaves are compared by keys[i];
+ * exhausted leaves (done[i]) lose to everything.
+ */
+typedef struct {
+    size_t k;
+    size_t* nodes;
+    const int64_t* keys;
+    const bool* done;
+} LoserTree;
+
+int loser_tree_init(LoserTree* tree, size_t k, const int64_t* keys, const bool* done);
+size_t loser_tree_winner(const LoserTree* tree);
+void loser_tree_replay(LoserTree* tree, size_t leaf);
+void loser_tree_free(LoserTree* tree);
+
+#endif
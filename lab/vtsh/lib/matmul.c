@@ -0,0 +1,258 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "matmul.h"
+#include "pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATMUL_X86 1
+#endif
+
+/* Rows of A per micro-tile; the panel width NR depends on the kernel. */
+#define MR 4
+#define NR_MAX 32
+/* B blocks of KC x NC ints (512 KiB) stay in L2/L3 while A rows stream past. */
+#define KC 256
+#define NC 512
+/* Rows of C per parallel task. */
+#define MC 64
+
+typedef void (*MicroKernel)(size_t kc, const int* const* a, const int* b, int* tile);
+
+/* tile[MR][nr] = sum over k of a[r][k] * b[k][0..nr), with b packed k-major, nr wide. */
+static void kernel_scalar(size_t kc, const int* const* a, const int* b, int* tile) {
+    enum { NR = 8 };
+    uint32_t acc[MR][NR] = {{0}};
+    for (size_t k = 0; k < kc; k++) {
+        for (int r = 0; r < MR; r++) {
+            uint32_t av = (uint32_t)a[r][k];
+            for (int c = 0; c < NR; c++) {
+                acc[r][c] += av * (uint32_t)b[c];
+            }
+        }
+        b += NR;
+    }
+    for (int r = 0; r < MR; r++) {
+        for (int c = 0; c < NR; c++) {
+            tile[r * NR_MAX + c] = (int)acc[r][c];
+        }
+    }
+}
+
+#ifdef MATMUL_X86
+__attribute__((target("avx2")))
+static void kernel_avx2(size_t kc, const int* const* a, const int* b, int* tile) {
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+    for (size_t k = 0; k < kc; k++) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)b);
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(b + 8));
+        __m256i a0 = _mm256_set1_epi32(a[0][k]);
+        __m256i a1 = _mm256_set1_epi32(a[1][k]);
+        __m256i a2 = _mm256_set1_epi32(a[2][k]);
+        __m256i a3 = _mm256_set1_epi32(a[3][k]);
+        c00 = _mm256_add_epi32(c00, _mm256_mullo_epi32(a0, b0));
+        c01 = _mm256_add_epi32(c01, _mm256_mullo_epi32(a0, b1));
+        c10 = _mm256_add_epi32(c10, _mm256_mullo_epi32(a1, b0));
+        c11 = _mm256_add_epi32(c11, _mm256_mullo_epi32(a1, b1));
+        c20 = _mm256_add_epi32(c20, _mm256_mullo_epi32(a2, b0));
+        c21 = _mm256_add_epi32(c21, _mm256_mullo_epi32(a2, b1));
+        c30 = _mm256_add_epi32(c30, _mm256_mullo_epi32(a3, b0));
+        c31 = _mm256_add_epi32(c31, _mm256_mullo_epi32(a3, b1));
+        b += 16;
+    }
+    _mm256_storeu_si256((__m256i*)(tile + 0 * NR_MAX), c00);
+    _mm256_storeu_si256((__m256i*)(tile + 0 * NR_MAX + 8), c01);
+    _mm256_storeu_si256((__m256i*)(tile + 1 * NR_MAX), c10);
+    _mm256_storeu_si256((__m256i*)(tile + 1 * NR_MAX + 8), c11);
+    _mm256_storeu_si256((__m256i*)(tile + 2 * NR_MAX), c20);
+    _mm256_storeu_si256((__m256i*)(tile + 2 * NR_MAX + 8), c21);
+    _mm256_storeu_si256((__m256i*)(tile + 3 * NR_MAX), c30);
+    _mm256_storeu_si256((__m256i*)(tile + 3 * NR_MAX + 8), c31);
+}
+
+__attribute__((target("avx512f")))
+static void kernel_avx512(size_t kc, const int* const* a, const int* b, int* tile) {
+    __m512i c00 = _mm512_setzero_si512(), c01 = _mm512_setzero_si512();
+    __m512i c10 = _mm512_setzero_si512(), c11 = _mm512_setzero_si512();
+    __m512i c20 = _mm512_setzero_si512(), c21 = _mm512_setzero_si512();
+    __m512i c30 = _mm512_setzero_si512(), c31 = _mm512_setzero_si512();
+    for (size_t k = 0; k < kc; k++) {
+        __m512i b0 = _mm512_loadu_si512((const void*)b);
+        __m512i b1 = _mm512_loadu_si512((const void*)(b + 16));
+        __m512i a0 = _mm512_set1_epi32(a[0][k]);
+        __m512i a1 = _mm512_set1_epi32(a[1][k]);
+        __m512i a2 = _mm512_set1_epi32(a[2][k]);
+        __m512i a3 = _mm512_set1_epi32(a[3][k]);
+        c00 = _mm512_add_epi32(c00, _mm512_mullo_epi32(a0, b0));
+        c01 = _mm512_add_epi32(c01, _mm512_mullo_epi32(a0, b1));
+        c10 = _mm512_add_epi32(c10, _mm512_mullo_epi32(a1, b0));
+        c11 = _mm512_add_epi32(c11, _mm512_mullo_epi32(a1, b1));
+        c20 = _mm512_add_epi32(c20, _mm512_mullo_epi32(a2, b0));
+        c21 = _mm512_add_epi32(c21, _mm512_mullo_epi32(a2, b1));
+        c30 = _mm512_add_epi32(c30, _mm512_mullo_epi32(a3, b0));
+        c31 = _mm512_add_epi32(c31, _mm512_mullo_epi32(a3, b1));
+        b += 32;
+    }
+    _mm512_storeu_si512((void*)(tile + 0 * NR_MAX), c00);
+    _mm512_storeu_si512((void*)(tile + 0 * NR_MAX + 16), c01);
+    _mm512_storeu_si512((void*)(tile + 1 * NR_MAX), c10);
+    _mm512_storeu_si512((void*)(tile + 1 * NR_MAX + 16), c11);
+    _mm512_storeu_si512((void*)(tile + 2 * NR_MAX), c20);
+    _mm512_storeu_si512((void*)(tile + 2 * NR_MAX + 16), c21);
+    _mm512_storeu_si512((void*)(tile + 3 * NR_MAX), c30);
+    _mm512_storeu_si512((void*)(tile + 3 * NR_MAX + 16), c31);
+}
+#endif
+
+static bool kernel_supported(MatmulKernel kernel) {
+    switch (kernel) {
+    case MATMUL_SCALAR:
+        return true;
+#ifdef MATMUL_X86
+    case MATMUL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    case MATMUL_AVX512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+int matmul_select_kernel(MatmulKernel requested, MatmulKernel* selected) {
+    if (requested != MATMUL_AUTO) {
+        if (!kernel_supported(requested)) {
+            return -1;
+        }
+        *selected = requested;
+        return 0;
+    }
+    if (kernel_supported(MATMUL_AVX512)) {
+        *selected = MATMUL_AVX512;
+    } else if (kernel_supported(MATMUL_AVX2)) {
+        *selected = MATMUL_AVX2;
+    } else {
+        *selected = MATMUL_SCALAR;
+    }
+    return 0;
+}
+
+const char* matmul_kernel_name(MatmulKernel kernel) {
+    switch (kernel) {
+    case MATMUL_SCALAR:
+        return "scalar";
+    case MATMUL_AVX2:
+        return "avx2";
+    case MATMUL_AVX512:
+        return "avx512";
+    default:
+        return "auto";
+    }
+}
+
+/* Copies B[pc..pc+kc) x [jc..jc+nc) into nr-wide panels, zero-padding the last one. */
+static void pack_b(const int* B, size_t n, size_t pc, size_t kc, size_t jc, size_t nc, size_t nr, int* packed) {
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        size_t width = nc - jr < nr ? nc - jr : nr;
+        for (size_t k = 0; k < kc; k++) {
+            const int* src = B + (pc + k) * n + jc + jr;
+            memcpy(packed, src, width * sizeof(int));
+            memset(packed + width, 0, (nr - width) * sizeof(int));
+            packed += nr;
+        }
+    }
+}
+
+typedef struct {
+    const int* A;
+    int* C;
+    size_t n;
+    size_t nr;
+    const int* packed;
+    MicroKernel micro;
+} MatmulJob;
+
+/* B block (jc, pc) sits at jc * n + padded(nc) * pc; every block but the last is NC wide. */
+static size_t block_offset(size_t n, size_t nr, size_t jc, size_t pc) {
+    size_t nc = n - jc < NC ? n - jc : NC;
+    return jc * n + (nc + nr - 1) / nr * nr * pc;
+}
+
+/* Computes rows [block * MC, block * MC + MC) of C against the packed B. */
+static void matmul_rows(void* arg, size_t block) {
+    const MatmulJob* job = arg;
+    size_t n = job->n;
+    size_t nr = job->nr;
+    size_t row_end = (block + 1) * MC < n ? (block + 1) * MC : n;
+    int tile[MR * NR_MAX];
+
+    for (size_t jc = 0; jc < n; jc += NC) {
+        size_t nc = n - jc < NC ? n - jc : NC;
+        for (size_t pc = 0; pc < n; pc += KC) {
+            size_t kc = n - pc < KC ? n - pc : KC;
+            const int* packed = job->packed + block_offset(n, nr, jc, pc);
+
+            for (size_t ic = block * MC; ic < row_end; ic += MR) {
+                size_t mr = row_end - ic < MR ? row_end - ic : MR;
+                /* Rows past the edge repeat the last row; their results are dropped. */
+                const int* a[MR];
+                for (size_t r = 0; r < MR; r++) {
+                    a[r] = job->A + (ic + (r < mr ? r : mr - 1)) * n + pc;
+                }
+
+                for (size_t jr = 0; jr < nc; jr += nr) {
+                    size_t width = nc - jr < nr ? nc - jr : nr;
+                    job->micro(kc, a, packed + jr * kc, tile);
+                    for (size_t r = 0; r < mr; r++) {
+                        int* c = job->C + (ic + r) * n + jc + jr;
+                        for (size_t col = 0; col < width; col++) {
+                            c[col] = (int)((uint32_t)c[col] + (uint32_t)tile[r * NR_MAX + col]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+int matmul_int(const int* A, const int* B, int* C, size_t n, MatmulKernel kernel, int threads) {
+    MatmulJob job = {A, C, n, 8, NULL, kernel_scalar};
+#ifdef MATMUL_X86
+    if (kernel == MATMUL_AVX2) {
+        job.micro = kernel_avx2;
+        job.nr = 16;
+    } else if (kernel == MATMUL_AVX512) {
+        job.micro = kernel_avx512;
+        job.nr = 32;
+    }
+#endif
+
+    /* All of B is packed once up front and shared read-only by the row blocks. */
+    size_t last_jc = (n - 1) / NC * NC;
+    size_t packed_size = block_offset(n, job.nr, last_jc, n);
+    int* packed = malloc(packed_size * sizeof(int));
+    if (!packed) {
+        return -1;
+    }
+    for (size_t jc = 0; jc < n; jc += NC) {
+        size_t nc = n - jc < NC ? n - jc : NC;
+        for (size_t pc = 0; pc < n; pc += KC) {
+            size_t kc = n - pc < KC ? n - pc : KC;
+            pack_b(B, n, pc, kc, jc, nc, job.nr, packed + block_offset(n, job.nr, jc, pc));
+        }
+    }
+    job.packed = packed;
+
+    memset(C, 0, n * n * sizeof(int));
+    pool_parallel_for((n + MC - 1) / MC, threads, matmul_rows, &job);
+
+    free(packed);
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef MATMUL_H
+#define MATMUL_H
+
+#include <stddef.h>
+
+typedef enum {
+    MATMUL_AUTO,
+    MATMUL_SCALAR,
+    MATMUL_AVX2,
+    MATMUL_AVX512
+} MatmulKernel;
+
+/* Picks the widest kernel the CPU and OS support, or checks a requested one. */
+int matmul_select_kernel(MatmulKernel requested, MatmulKernel* selected);
+const char* matmul_kernel_name(MatmulKernel kernel);
+
+/*
+ * C = A * B for n x n row-major int matrices. B is packed into column
+ * panels per cache block, so the inner kernel streams both operands
+ * contiguously. Blocks of rows are spread over `threads` pool threads.
+ * Arithmetic wraps modulo 2^32.
+ */
+int matmul_int(const int* A, const int* B, int* C, size_t n, MatmulKernel kernel, int threads);
+
+#endif
@@ -0,0 +1,229 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "md5x.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MD5X_X86 1
+#endif
+
+#define MD5_BLOCK_SIZE 64
+/* The bit length goes into the last 8 bytes of the final block. */
+#define MD5_LENGTH_OFFSET 56
+
+typedef uint32_t v4u __attribute__((vector_size(16)));
+typedef uint32_t v8u __attribute__((vector_size(32)));
+typedef uint32_t v16u __attribute__((vector_size(64)));
+
+typedef uint32_t LaneWords[MD5X_MAX_LANES];
+
+static const uint32_t md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const int md5_shift[4][4] = {
+    {7, 12, 17, 22},
+    {5, 9, 14, 20},
+    {4, 11, 16, 23},
+    {6, 10, 15, 21},
+};
+
+/*
+ * One MD5 compression over every lane of vector type V. The same source is
+ * instantiated per vector width below; lanes whose active mask is zero keep
+ * their previous state.
+ */
+#define MD5X_STEP(V, f, g, i)                                                   \
+    do {                                                                        \
+        V t = a + (f) + x[(g)] + md5_k[(i)];                                    \
+        int s = md5_shift[(i) / 16][(i) % 4];                                   \
+        a = d;                                                                  \
+        d = c;                                                                  \
+        c = b;                                                                  \
+        b = b + ((t << s) | (t >> (32 - s)));                                   \
+    } while (0)
+
+#define MD5X_COMPRESS(V)                                                        \
+    V h[4], x[16], mask;                                                        \
+    for (int w = 0; w < 4; w++) {                                               \
+        memcpy(&h[w], state[w], sizeof(V));                                     \
+    }                                                                           \
+    for (int w = 0; w < 16; w++) {                                              \
+        memcpy(&x[w], words[w], sizeof(V));                                     \
+    }                                                                           \
+    memcpy(&mask, active, sizeof(V));                                           \
+    V a = h[0], b = h[1], c = h[2], d = h[3];                                   \
+    for (int i = 0; i < 16; i++) {                                              \
+        MD5X_STEP(V, d ^ (b & (c ^ d)), i, i);                                  \
+    }                                                                           \
+    for (int i = 16; i < 32; i++) {                                             \
+        MD5X_STEP(V, c ^ (d & (b ^ c)), (5 * i + 1) & 15, i);                   \
+    }                                                                           \
+    for (int i = 32; i < 48; i++) {                                             \
+        MD5X_STEP(V, b ^ c ^ d, (3 * i + 5) & 15, i);                           \
+    }                                                                           \
+    for (int i = 48; i < 64; i++) {                                             \
+        MD5X_STEP(V, c ^ (b | ~d), (7 * i) & 15, i);                            \
+    }                                                                           \
+    V out[4] = {h[0] + a, h[1] + b, h[2] + c, h[3] + d};                        \
+    for (int w = 0; w < 4; w++) {                                               \
+        h[w] = (out[w] & mask) | (h[w] & ~mask);                                \
+        memcpy(state[w], &h[w], sizeof(V));                                     \
+    }
+
+typedef void (*BlockFunction)(LaneWords* state, const LaneWords* words, const uint32_t* active);
+
+static void md5_block_x4(LaneWords* state, const LaneWords* words, const uint32_t* active) {
+    MD5X_COMPRESS(v4u)
+}
+
+#ifdef MD5X_X86
+__attribute__((target("avx2")))
+static void md5_block_x8(LaneWords* state, const LaneWords* words, const uint32_t* active) {
+    MD5X_COMPRESS(v8u)
+}
+
+__attribute__((target("avx512f")))
+static void md5_block_x16(LaneWords* state, const LaneWords* words, const uint32_t* active) {
+    MD5X_COMPRESS(v16u)
+}
+#endif
+
+static bool lanes_supported(int lanes) {
+    switch (lanes) {
+    case 4:
+        return true;
+#ifdef MD5X_X86
+    case 8:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    case 16:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+int md5x_select_lanes(int requested, int* lanes) {
+    if (requested != 0) {
+        if (!lanes_supported(requested)) {
+            return -1;
+        }
+        *lanes = requested;
+        return 0;
+    }
+    *lanes = lanes_supported(16) ? 16 : lanes_supported(8) ? 8 : 4;
+    return 0;
+}
+
+typedef enum {
+    LANE_DATA,
+    LANE_LENGTH,
+    LANE_DONE
+} LanePhase;
+
+typedef struct {
+    uint64_t length;
+    LanePhase phase;
+} Lane;
+
+static void put_length(unsigned char* block, uint64_t length) {
+    uint64_t bits = length * 8;
+    for (int i = 0; i < 8; i++) {
+        block[MD5_LENGTH_OFFSET + i] = (unsigned char)(bits >> (8 * i));
+    }
+}
+
+/* Produces the lane's next block, appending the MD5 padding once its message runs out. */
+static bool next_block(Lane* lane, void* stream, Md5xReader read, unsigned char* block) {
+    if (lane->phase == LANE_DONE) {
+        return false;
+    }
+    if (lane->phase == LANE_LENGTH) {
+        memset(block, 0, MD5_BLOCK_SIZE);
+        put_length(block, lane->length);
+        lane->phase = LANE_DONE;
+        return true;
+    }
+
+    size_t n = read(stream, block, MD5_BLOCK_SIZE);
+    lane->length += n;
+    if (n == MD5_BLOCK_SIZE) {
+        return true;
+    }
+    block[n] = 0x80;
+    memset(block + n + 1, 0, MD5_BLOCK_SIZE - n - 1);
+    if (n + 1 <= MD5_LENGTH_OFFSET) {
+        put_length(block, lane->length);
+        lane->phase = LANE_DONE;
+    } else {
+        lane->phase = LANE_LENGTH;
+    }
+    return true;
+}
+
+void md5x_digest(void* const* streams, size_t count, Md5xReader read, int lanes,
+                 unsigned char (*digests)[MD5X_DIGEST_LENGTH]) {
+    BlockFunction block_function = md5_block_x4;
+#ifdef MD5X_X86
+    if (lanes == 8) {
+        block_function = md5_block_x8;
+    } else if (lanes == 16) {
+        block_function = md5_block_x16;
+    }
+#endif
+
+    static const uint32_t initial[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    LaneWords state[4];
+    LaneWords words[16];
+    uint32_t active[MD5X_MAX_LANES];
+    Lane lane[MD5X_MAX_LANES];
+    unsigned char block[MD5_BLOCK_SIZE];
+
+    memset(words, 0, sizeof(words));
+    for (int l = 0; l < MD5X_MAX_LANES; l++) {
+        for (int w = 0; w < 4; w++) {
+            state[w][l] = initial[w];
+        }
+        lane[l].length = 0;
+        lane[l].phase = (size_t)l < count ? LANE_DATA : LANE_DONE;
+    }
+
+    for (;;) {
+        bool any = false;
+        for (int l = 0; l < lanes; l++) {
+            bool has_block = next_block(&lane[l], (size_t)l < count ? streams[l] : NULL, read, block);
+            active[l] = has_block ? UINT32_MAX : 0;
+            if (!has_block) {
+                continue;
+            }
+            any = true;
+            /* Transposed so that word w of every lane forms one vector. */
+            for (int w = 0; w < 16; w++) {
+                const unsigned char* p = block + 4 * w;
+                words[w][l] = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+            }
+        }
+        if (!any) {
+            break;
+        }
+        block_function(state, words, active);
+    }
+
+    for (size_t l = 0; l < count; l++) {
+        for (int w = 0; w < 4; w++) {
+            for (int i = 0; i < 4; i++) {
+                digests[l][4 * w + i] = (unsigned char)(state[w][l] >> (8 * i));
+            }
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef MD5X_H
+#define MD5X_H
+
+#include <stddef.h>
+
+#define MD5X_MAX_LANES 16
+#define MD5X_DIGEST_LENGTH 16
+
+/* Fills up to capacity bytes from a message; a short read means the message ended. */
+typedef size_t (*Md5xReader)(void* stream, unsigned char* dst, size_t capacity);
+
+/*
+ * Checks a requested lane count (4, 8 or 16) against the CPU, or picks the
+ * widest supported one when requested is 0.
+ */
+int md5x_select_lanes(int requested, int* lanes);
+
+/*
+ * Multi-buffer MD5: hashes up to `lanes` independent messages at once, one
+ * per SIMD lane, pulling 64-byte blocks from each stream as it goes so no
+ * message is ever held in memory. Lanes whose message ended sit out the
+ * remaining blocks.
+ */
+void md5x_digest(void* const* streams, size_t count, Md5xReader read, int lanes,
+                 unsigned char (*digests)[MD5X_DIGEST_LENGTH]);
+
+#endif
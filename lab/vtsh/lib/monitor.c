@@ -0,0 +1,425 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "monitor.h"
+
+/* Size of the /proc read buffer; /proc/stat is only read up to its first line. */
+#define MONITOR_BUFFER_SIZE (64 * 1024)
+#define MONITOR_STAT_PREFIX 512
+/* Initial size of the row buffer; it grows for long command names. */
+#define MONITOR_ROW_SIZE 1024
+
+/* Row columns after command_id, command, event and t_ms, in output order. */
+static const char* columns[] = {"cpu_user", "cpu_system", "cpu_iowait", "cpu_idle", "cpu_steal",
+                                "read_kbs", "write_kbs", "disk_util", "proc_cpu", "proc_rss_kb",
+                                "psi_cpu_some", "psi_io_some", "psi_io_full", "psi_memory_some",
+                                "psi_memory_full"};
+
+#define COLUMN_COUNT (sizeof(columns) / sizeof(columns[0]))
+
+static const char* pressure_paths[3] = {"/proc/pressure/cpu", "/proc/pressure/io", "/proc/pressure/memory"};
+
+/* Re-reads a whole /proc file from the start; returns the length read or -1. */
+static ssize_t read_proc(int fd, char* buffer, size_t size) {
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t length = pread(fd, buffer, size - 1, 0);
+    buffer[length > 0 ? length : 0] = '\0';
+    return length;
+}
+
+static double elapsed_ms(const struct timespec* from, const struct timespec* to) {
+    return (double)(to->tv_sec - from->tv_sec) * 1000.0 + (double)(to->tv_nsec - from->tv_nsec) / 1000000.0;
+}
+
+/* Whole disks only: partitions, loop and RAM devices, and device-mapper targets would count I/O twice. */
+static bool is_disk(const char* name) {
+    char path[64];
+    if (strncmp(name, "loop", 4) == 0 || strncmp(name, "ram", 3) == 0 || strncmp(name, "zram", 4) == 0 ||
+        strncmp(name, "dm-", 3) == 0) {
+        return false;
+    }
+    snprintf(path, sizeof(path), "/sys/block/%s", name);
+    return access(path, F_OK) == 0;
+}
+
+static void find_disks(Monitor* monitor) {
+    monitor->disk_count = 0;
+    if (read_proc(monitor->diskstats_fd, monitor->buffer, monitor->buffer_size) <= 0) {
+        return;
+    }
+    char* save;
+    for (char* line = strtok_r(monitor->buffer, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char name[32];
+        if (sscanf(line, "%*u %*u %31s", name) == 1 && is_disk(name) && monitor->disk_count < MONITOR_MAX_DISKS) {
+            strcpy(monitor->disks[monitor->disk_count++], name);
+        }
+    }
+}
+
+static void sample_cpu(Monitor* monitor, MonitorSample* sample) {
+    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+    if (read_proc(monitor->stat_fd, monitor->buffer, MONITOR_STAT_PREFIX) <= 0 ||
+        sscanf(monitor->buffer, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait,
+               &irq, &softirq, &steal) != 8) {
+        return;
+    }
+    sample->cpu_user = user + nice;
+    sample->cpu_system = system + irq + softirq;
+    sample->cpu_iowait = iowait;
+    sample->cpu_idle = idle;
+    sample->cpu_steal = steal;
+}
+
+static void sample_disks(Monitor* monitor, MonitorSample* sample) {
+    if (read_proc(monitor->diskstats_fd, monitor->buffer, monitor->buffer_size) <= 0) {
+        return;
+    }
+    char* save;
+    for (char* line = strtok_r(monitor->buffer, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char name[32];
+        unsigned long long read_sectors, write_sectors, io_ms;
+        if (sscanf(line, "%*u %*u %31s %*u %*u %llu %*u %*u %*u %llu %*u %*u %llu", name, &read_sectors,
+                   &write_sectors, &io_ms) != 4) {
+            continue;
+        }
+        for (int i = 0; i < monitor->disk_count; i++) {
+            if (strcmp(name, monitor->disks[i]) == 0) {
+                sample->read_sectors += read_sectors;
+                sample->write_sectors += write_sectors;
+                sample->io_ms[i] = io_ms;
+                break;
+            }
+        }
+    }
+}
+
+static void sample_process(Monitor* monitor, MonitorSample* sample) {
+    /* comm may contain spaces and parentheses, so fields are counted from the last ')'. */
+    char* fields = read_proc(monitor->process_fd, monitor->buffer, monitor->buffer_size) > 0
+                       ? strrchr(monitor->buffer, ')')
+                       : NULL;
+    char state;
+    unsigned long utime, stime;
+    long rss;
+    if (fields && sscanf(fields + 2, "%c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %*d %*d %*d %*d %*d %*d "
+                                     "%*u %*u %ld", &state, &utime, &stime, &rss) == 4) {
+        sample->process_valid = true;
+        sample->process_ticks = (uint64_t)utime + stime;
+        sample->process_rss_pages = state == 'Z' ? -1 : rss;
+    }
+}
+
+static void sample_pressure(Monitor* monitor, MonitorSample* sample) {
+    /* cpu reports some (and full since 5.13); io and memory report some and full. */
+    static const int slots[3][2] = {{0, -1}, {1, 2}, {3, 4}};
+    for (int i = 0; i < 3; i++) {
+        if (read_proc(monitor->pressure_fds[i], monitor->buffer, monitor->buffer_size) <= 0) {
+            continue;
+        }
+        const char* cursor = monitor->buffer;
+        for (int j = 0; j < 2 && slots[i][j] >= 0; j++) {
+            cursor = strstr(cursor, "total=");
+            if (!cursor) {
+                break;
+            }
+            cursor += strlen("total=");
+            sample->pressure[slots[i][j]] = strtoull(cursor, NULL, 10);
+        }
+    }
+}
+
+static void take_sample(Monitor* monitor, MonitorSample* sample) {
+    memset(sample, 0, sizeof(*sample));
+    sample->process_rss_pages = -1;
+    clock_gettime(CLOCK_MONOTONIC, &sample->time);
+    sample_cpu(monitor, sample);
+    sample_disks(monitor, sample);
+    sample_process(monitor, sample);
+    sample_pressure(monitor, sample);
+}
+
+/* Appends to the pending row; text that does not fit after the buffer failed to grow is dropped. */
+static void row_append(Monitor* monitor, const char* format, ...) {
+    for (;;) {
+        size_t room = monitor->row_capacity - monitor->row_length;
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(monitor->row + monitor->row_length, room, format, args);
+        va_end(args);
+        if (length < 0) {
+            return;
+        }
+        if ((size_t)length < room) {
+            monitor->row_length += (size_t)length;
+            return;
+        }
+        size_t capacity = monitor->row_capacity * 2 + (size_t)length;
+        char* grown = realloc(monitor->row, capacity);
+        if (!grown) {
+            return;
+        }
+        monitor->row = grown;
+        monitor->row_capacity = capacity;
+    }
+}
+
+static void row_flush(Monitor* monitor) {
+    const char* data = monitor->row;
+    size_t length = monitor->row_length;
+    while (length > 0) {
+        ssize_t written = write(monitor->output_fd, data, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            break;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    monitor->row_length = 0;
+}
+
+static void write_string(Monitor* monitor, const char* text) {
+    row_append(monitor, "\"");
+    for (const char* c = text; *c; c++) {
+        if (*c == '"') {
+            row_append(monitor, monitor->format == MONITOR_CSV ? "\"\"" : "\\\"");
+        } else if (monitor->format == MONITOR_JSON && (*c == '\\' || (unsigned char)*c < 0x20)) {
+            row_append(monitor, "\\u%04x", (unsigned char)*c);
+        } else {
+            row_append(monitor, "%c", *c);
+        }
+    }
+    row_append(monitor, "\"");
+}
+
+/* A value that cannot be computed is left empty in CSV and written as null in JSON. */
+static void write_value(Monitor* monitor, const char* name, bool valid, double value) {
+    if (monitor->format == MONITOR_JSON) {
+        row_append(monitor, ", \"%s\": ", name);
+        if (!valid) {
+            row_append(monitor, "null");
+            return;
+        }
+    } else {
+        row_append(monitor, ",");
+        if (!valid) {
+            return;
+        }
+    }
+    row_append(monitor, "%.2f", value);
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+/* Rates cover the span from previous to current; the start row has no previous sample and only shows the RSS. */
+static void write_row(Monitor* monitor, const char* event, const MonitorSample* previous,
+                      const MonitorSample* current) {
+    double values[COLUMN_COUNT];
+    bool valid[COLUMN_COUNT];
+    for (size_t i = 0; i < COLUMN_COUNT; i++) {
+        values[i] = 0.0;
+        valid[i] = previous != NULL;
+    }
+
+    if (previous) {
+        double ms = elapsed_ms(&previous->time, &current->time);
+        double seconds = ms > 0 ? ms / 1000.0 : 1e-9;
+        uint64_t user = current->cpu_user - previous->cpu_user;
+        uint64_t system = current->cpu_system - previous->cpu_system;
+        uint64_t iowait = current->cpu_iowait - previous->cpu_iowait;
+        uint64_t idle = current->cpu_idle - previous->cpu_idle;
+        uint64_t steal = current->cpu_steal - previous->cpu_steal;
+        uint64_t total = user + system + iowait + idle + steal;
+        /* /proc/stat and the disks' busy time advance in clock ticks, so very short spans may show nothing. */
+        valid[0] = valid[1] = valid[2] = valid[3] = valid[4] = total > 0;
+        values[0] = percent(user, total);
+        values[1] = percent(system, total);
+        values[2] = percent(iowait, total);
+        values[3] = percent(idle, total);
+        values[4] = percent(steal, total);
+        /* diskstats sectors are always 512 bytes. */
+        values[5] = (double)(current->read_sectors - previous->read_sectors) / 2.0 / seconds;
+        values[6] = (double)(current->write_sectors - previous->write_sectors) / 2.0 / seconds;
+        for (int i = 0; i < monitor->disk_count; i++) {
+            double util = 100.0 * (double)(current->io_ms[i] - previous->io_ms[i]) / (seconds * 1000.0);
+            values[7] = util > values[7] ? (util < 100.0 ? util : 100.0) : values[7];
+        }
+        valid[7] = monitor->disk_count > 0;
+        values[8] = 100.0 * (double)(current->process_ticks - previous->process_ticks) /
+                    (double)sysconf(_SC_CLK_TCK) / seconds;
+        valid[8] = current->process_valid && previous->process_valid;
+        for (int i = 0; i < 5; i++) {
+            values[10 + i] = 100.0 * (double)(current->pressure[i] - previous->pressure[i]) / (seconds * 1e6);
+            valid[10 + i] = monitor->pressure_fds[i == 0 ? 0 : (i + 1) / 2] >= 0;
+        }
+    }
+    values[9] = (double)current->process_rss_pages * (double)sysconf(_SC_PAGESIZE) / 1024.0;
+    valid[9] = current->process_rss_pages >= 0;
+
+    double t_ms = elapsed_ms(&monitor->start.time, &current->time);
+    if (monitor->format == MONITOR_JSON) {
+        row_append(monitor, "%s{\"command_id\": %lu, \"command\": ", monitor->rows_written ? ",\n" : "",
+                   monitor->command_id);
+        write_string(monitor, monitor->command);
+        row_append(monitor, ", \"event\": \"%s\", \"t_ms\": %.3f", event, t_ms);
+    } else {
+        row_append(monitor, "%lu,", monitor->command_id);
+        write_string(monitor, monitor->command);
+        row_append(monitor, ",%s,%.3f", event, t_ms);
+    }
+    for (size_t i = 0; i < COLUMN_COUNT; i++) {
+        write_value(monitor, columns[i], valid[i], values[i]);
+    }
+    row_append(monitor, monitor->format == MONITOR_JSON ? "}" : "\n");
+    row_flush(monitor);
+    monitor->rows_written = true;
+}
+
+static void add_ms(struct timespec* time, unsigned ms) {
+    time->tv_sec += ms / 1000;
+    time->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (time->tv_nsec >= 1000000000L) {
+        time->tv_sec++;
+        time->tv_nsec -= 1000000000L;
+    }
+}
+
+/* Deadlines are absolute, so slow samples do not make the timeline drift; missed ones are skipped. */
+static void* sampler_main(void* arg) {
+    Monitor* monitor = arg;
+    struct timespec deadline = monitor->start.time;
+    add_ms(&deadline, monitor->interval_ms);
+
+    pthread_mutex_lock(&monitor->lock);
+    while (!monitor->stop) {
+        if (pthread_cond_timedwait(&monitor->changed, &monitor->lock, &deadline) != ETIMEDOUT) {
+            continue;
+        }
+        pthread_mutex_unlock(&monitor->lock);
+        MonitorSample sample;
+        take_sample(monitor, &sample);
+        write_row(monitor, "sample", &monitor->last, &sample);
+        monitor->last = sample;
+        while (elapsed_ms(&deadline, &sample.time) >= 0) {
+            add_ms(&deadline, monitor->interval_ms);
+        }
+        pthread_mutex_lock(&monitor->lock);
+    }
+    pthread_mutex_unlock(&monitor->lock);
+    return NULL;
+}
+
+int monitor_open(Monitor* monitor, const char* path, unsigned interval_ms) {
+    memset(monitor, 0, sizeof(*monitor));
+    size_t length = strlen(path);
+    monitor->format = length >= 5 && strcmp(path + length - 5, ".json") == 0 ? MONITOR_JSON : MONITOR_CSV;
+    monitor->interval_ms = interval_ms;
+    monitor->process_fd = -1;
+    monitor->output_fd = -1;
+    monitor->buffer_size = MONITOR_BUFFER_SIZE;
+    monitor->buffer = malloc(monitor->buffer_size);
+    monitor->row_capacity = MONITOR_ROW_SIZE;
+    monitor->row = malloc(monitor->row_capacity);
+    monitor->stat_fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+    monitor->diskstats_fd = open("/proc/diskstats", O_RDONLY | O_CLOEXEC);
+    /* Pressure stall information needs CONFIG_PSI; its columns stay empty without it. */
+    for (int i = 0; i < 3; i++) {
+        monitor->pressure_fds[i] = open(pressure_paths[i], O_RDONLY | O_CLOEXEC);
+    }
+    monitor->output_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (!monitor->buffer || !monitor->row || monitor->stat_fd < 0 || monitor->output_fd < 0) {
+        int error = monitor->buffer && monitor->row ? errno : ENOMEM;
+        monitor_close(monitor);
+        errno = error;
+        return -1;
+    }
+    find_disks(monitor);
+
+    if (monitor->format == MONITOR_JSON) {
+        row_append(monitor, "[\n");
+    } else {
+        row_append(monitor, "command_id,command,event,t_ms");
+        for (size_t i = 0; i < COLUMN_COUNT; i++) {
+            row_append(monitor, ",%s", columns[i]);
+        }
+        row_append(monitor, "\n");
+    }
+    row_flush(monitor);
+    return 0;
+}
+
+void monitor_close(Monitor* monitor) {
+    if (monitor->output_fd >= 0 && monitor->row && monitor->format == MONITOR_JSON) {
+        row_append(monitor, "\n]\n");
+        row_flush(monitor);
+    }
+    int* fds[] = {&monitor->output_fd, &monitor->stat_fd, &monitor->diskstats_fd, &monitor->pressure_fds[0],
+                  &monitor->pressure_fds[1], &monitor->pressure_fds[2]};
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (*fds[i] >= 0) {
+            close(*fds[i]);
+        }
+        *fds[i] = -1;
+    }
+    free(monitor->buffer);
+    free(monitor->row);
+    monitor->buffer = NULL;
+    monitor->row = NULL;
+}
+
+void monitor_begin(Monitor* monitor, const char* command, pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    monitor->process_fd = open(path, O_RDONLY | O_CLOEXEC);
+    monitor->command = command;
+    monitor->command_id++;
+    take_sample(monitor, &monitor->start);
+    monitor->last = monitor->start;
+    write_row(monitor, "start", NULL, &monitor->start);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&monitor->lock, NULL);
+    pthread_cond_init(&monitor->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    monitor->stop = false;
+    monitor->running = pthread_create(&monitor->thread, NULL, sampler_main, monitor) == 0;
+    if (!monitor->running) {
+        fprintf(stderr, "monitor: cannot start the sampler thread, recording start and end only\n");
+    }
+}
+
+void monitor_end(Monitor* monitor) {
+    if (monitor->running) {
+        pthread_mutex_lock(&monitor->lock);
+        monitor->stop = true;
+        pthread_cond_broadcast(&monitor->changed);
+        pthread_mutex_unlock(&monitor->lock);
+        pthread_join(monitor->thread, NULL);
+        monitor->running = false;
+    }
+    pthread_mutex_destroy(&monitor->lock);
+    pthread_cond_destroy(&monitor->changed);
+
+    MonitorSample sample;
+    take_sample(monitor, &sample);
+    write_row(monitor, "end", &monitor->last, &sample);
+    if (monitor->process_fd >= 0) {
+        close(monitor->process_fd);
+        monitor->process_fd = -1;
+    }
+    monitor->command = NULL;
+}
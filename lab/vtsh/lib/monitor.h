@@ -0,0 +1,88 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define MONITOR_DEFAULT_INTERVAL_MS 100
+#define MONITOR_MAX_DISKS 32
+
+typedef enum {
+    MONITOR_CSV,
+    MONITOR_JSON
+} MonitorFormat;
+
+/* Cumulative counters read at one point in time; rows are the differences of two samples. */
+typedef struct {
+    struct timespec time;
+    uint64_t cpu_user;
+    uint64_t cpu_system;
+    uint64_t cpu_iowait;
+    uint64_t cpu_idle;
+    uint64_t cpu_steal;
+    uint64_t read_sectors;
+    uint64_t write_sectors;
+    uint64_t io_ms[MONITOR_MAX_DISKS];
+    bool process_valid;
+    uint64_t process_ticks;
+    /* -1 once the process has exited and only its zombie is left. */
+    long process_rss_pages;
+    /* Stall time in microseconds: cpu some, io some, io full, memory some, memory full. */
+    uint64_t pressure[5];
+} MonitorSample;
+
+/*
+ * Samples /proc/stat, /proc/diskstats, /proc/<pid>/stat and
+ * /proc/pressure/{cpu,io,memory} every interval_ms while a command runs and
+ * appends one row per sample to a CSV or JSON timeline. Each command gets
+ * a start row at t = 0 and an end row at its exit. The /proc files stay
+ * open and are re-read with pread, so a sample costs a handful of syscalls.
+ * Each row is formatted into row and written with one write(2), so no
+ * stdio buffer or lock is shared with children the shell forks meanwhile.
+ */
+typedef struct {
+    int output_fd;
+    MonitorFormat format;
+    unsigned interval_ms;
+    int stat_fd;
+    int diskstats_fd;
+    int pressure_fds[3];
+    int disk_count;
+    char disks[MONITOR_MAX_DISKS][32];
+    char* buffer;
+    size_t buffer_size;
+    char* row;
+    size_t row_length;
+    size_t row_capacity;
+    unsigned long command_id;
+    bool rows_written;
+
+    /* Per command. Only stop is shared under lock; the rest belongs to the sampler while it runs. */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool running;
+    bool stop;
+    int process_fd;
+    const char* command;
+    MonitorSample start;
+    MonitorSample last;
+} Monitor;
+
+/* The format follows the file name: ".json" writes a JSON array, anything else CSV. */
+int monitor_open(Monitor* monitor, const char* path, unsigned interval_ms);
+void monitor_close(Monitor* monitor);
+
+/*
+ * Writes the start row and starts sampling pid, which must stay
+ * unreaped until monitor_end. command is only used while it runs.
+ */
+void monitor_begin(Monitor* monitor, const char* command, pid_t pid);
+
+/* Stops the sampler and writes the end row. */
+void monitor_end(Monitor* monitor);
+
+#endif
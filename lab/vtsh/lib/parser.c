@@ -0,0 +1,247 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "parser.h"
+
+typedef enum {
+    TOKEN_WORD,
+    TOKEN_AND,
+    TOKEN_OR,
+    TOKEN_SEMICOLON,
+    TOKEN_AMPERSAND,
+    TOKEN_END,
+    TOKEN_ERROR
+} TokenType;
+
+typedef struct WordList {
+    char* word;
+    struct WordList* next;
+} WordList;
+
+/*
+ * One token of lookahead. Unquoted words are appended to out, which is
+ * sized for the whole line: a word never grows when its quotes go away.
+ */
+typedef struct {
+    const char* input;
+    size_t pos;
+    char* out;
+    Arena* arena;
+    TokenType type;
+    char* word;
+    const char* error;
+    TokenType unexpected;
+} Parser;
+
+static const char* token_text(TokenType type) {
+    switch (type) {
+    case TOKEN_AND:
+        return "&&";
+    case TOKEN_OR:
+        return "||";
+    case TOKEN_SEMICOLON:
+        return ";";
+    case TOKEN_AMPERSAND:
+        return "&";
+    default:
+        return "newline";
+    }
+}
+
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool ends_word(char c) {
+    return c == '\0' || is_blank(c) || c == ';' || c == '&' || c == '|';
+}
+
+static void fail(Parser* parser, const char* error) {
+    parser->type = TOKEN_ERROR;
+    parser->error = error;
+}
+
+static void read_word(Parser* parser) {
+    const char* s = parser->input;
+    size_t pos = parser->pos;
+    char* out = parser->out;
+    parser->word = out;
+
+    while (!ends_word(s[pos])) {
+        char c = s[pos++];
+        if (c == '\'') {
+            while (s[pos] && s[pos] != '\'') {
+                *out++ = s[pos++];
+            }
+            if (!s[pos]) {
+                fail(parser, "unterminated quote");
+                return;
+            }
+            pos++;
+        } else if (c == '"') {
+            while (s[pos] && s[pos] != '"') {
+                if (s[pos] == '\\' && s[pos + 1] && strchr("\"\\$`", s[pos + 1])) {
+                    pos++;
+                }
+                *out++ = s[pos++];
+            }
+            if (!s[pos]) {
+                fail(parser, "unterminated quote");
+                return;
+            }
+            pos++;
+        } else if (c == '\\' && s[pos]) {
+            *out++ = s[pos++];
+        } else {
+            *out++ = c;
+        }
+    }
+    *out++ = '\0';
+    parser->out = out;
+    parser->pos = pos;
+    parser->type = TOKEN_WORD;
+}
+
+static void next_token(Parser* parser) {
+    const char* s = parser->input;
+    while (is_blank(s[parser->pos])) {
+        parser->pos++;
+    }
+
+    char c = s[parser->pos];
+    if (c == '\0' || c == '#') {
+        parser->type = TOKEN_END;
+    } else if (c == '&' || c == '|') {
+        bool doubled = s[parser->pos + 1] == c;
+        if (c == '|' && !doubled) {
+            fail(parser, "pipes are not supported");
+            return;
+        }
+        parser->type = c == '|' ? TOKEN_OR : doubled ? TOKEN_AND : TOKEN_AMPERSAND;
+        parser->pos += doubled ? 2 : 1;
+    } else if (c == ';') {
+        parser->type = TOKEN_SEMICOLON;
+        parser->pos++;
+    } else {
+        read_word(parser);
+    }
+}
+
+static AstNode* new_node(Parser* parser, AstType type, AstNode* left, AstNode* right) {
+    AstNode* node = arena_alloc(parser->arena, sizeof(AstNode));
+    if (!node) {
+        fail(parser, "out of memory");
+        return NULL;
+    }
+    memset(node, 0, sizeof(*node));
+    node->type = type;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+/* Words are chained while they are read, then laid out as a NULL-terminated argv. */
+static AstNode* parse_command(Parser* parser) {
+    if (parser->type != TOKEN_WORD) {
+        if (parser->type != TOKEN_ERROR) {
+            parser->unexpected = parser->type;
+            parser->type = TOKEN_ERROR;
+        }
+        return NULL;
+    }
+
+    WordList* first = NULL;
+    WordList** tail = &first;
+    int argc = 0;
+    while (parser->type == TOKEN_WORD) {
+        WordList* item = arena_alloc(parser->arena, sizeof(WordList));
+        if (!item) {
+            fail(parser, "out of memory");
+            return NULL;
+        }
+        item->word = parser->word;
+        item->next = NULL;
+        *tail = item;
+        tail = &item->next;
+        argc++;
+        next_token(parser);
+    }
+    if (parser->type == TOKEN_ERROR) {
+        return NULL;
+    }
+
+    AstNode* node = new_node(parser, AST_COMMAND, NULL, NULL);
+    char** args = arena_alloc(parser->arena, ((size_t)argc + 1) * sizeof(char*));
+    if (!node || !args) {
+        fail(parser, "out of memory");
+        return NULL;
+    }
+    int i = 0;
+    for (WordList* item = first; item; item = item->next) {
+        args[i++] = item->word;
+    }
+    args[argc] = NULL;
+    node->command.name = args[0];
+    node->command.args = args;
+    node->command.argc = argc;
+    return node;
+}
+
+static AstNode* parse_and_or(Parser* parser) {
+    AstNode* left = parse_command(parser);
+    while (left && (parser->type == TOKEN_AND || parser->type == TOKEN_OR)) {
+        AstType type = parser->type == TOKEN_AND ? AST_AND : AST_OR;
+        next_token(parser);
+        AstNode* right = parse_command(parser);
+        left = right ? new_node(parser, type, left, right) : NULL;
+    }
+    return left;
+}
+
+static AstNode* parse_list(Parser* parser) {
+    AstNode* list = NULL;
+    for (;;) {
+        AstNode* item = parse_and_or(parser);
+        if (!item) {
+            return NULL;
+        }
+        if (parser->type == TOKEN_AMPERSAND) {
+            item = new_node(parser, AST_BACKGROUND, item, NULL);
+            next_token(parser);
+        } else if (parser->type == TOKEN_SEMICOLON) {
+            next_token(parser);
+        }
+        if (!item || parser->type == TOKEN_ERROR) {
+            return NULL;
+        }
+        list = list ? new_node(parser, AST_SEQUENCE, list, item) : item;
+        if (!list || parser->type == TOKEN_END) {
+            return list;
+        }
+    }
+}
+
+int parse_line(const char* line, Arena* arena, AstNode** tree) {
+    size_t length = strlen(line);
+    Parser parser = {line, 0, arena_alloc(arena, length + 1), arena, TOKEN_END, NULL, NULL, TOKEN_END};
+    *tree = NULL;
+    if (!parser.out) {
+        printf("Syntax error: out of memory\n");
+        return -1;
+    }
+
+    next_token(&parser);
+    if (parser.type == TOKEN_END) {
+        return 0;
+    }
+    *tree = parse_list(&parser);
+    if (!*tree) {
+        if (parser.error) {
+            printf("Syntax error: %s\n", parser.error);
+        } else {
+            printf("Syntax error near unexpected '%s'\n", token_text(parser.unexpected));
+        }
+        return -1;
+    }
+    return 0;
+}
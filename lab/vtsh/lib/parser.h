@@ -0,0 +1,48 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "arena.h"
+
+typedef struct {
+    char* name;
+    char** args;
+    int argc;
+} Command;
+
+/*
+ * AST of one command line. AND/OR/SEQUENCE have both children; BACKGROUND
+ * runs its left child without waiting. Operators associate to the left,
+ * && and || bind tighter than ; and &, like in sh.
+ */
+typedef enum {
+    AST_COMMAND,
+    AST_AND,
+    AST_OR,
+    AST_SEQUENCE,
+    AST_BACKGROUND
+} AstType;
+
+typedef struct AstNode {
+    AstType type;
+    struct AstNode* left;
+    struct AstNode* right;
+    Command command;
+} AstNode;
+
+/*
+ * Grammar:
+ *   line    := [list] [comment]
+ *   list    := and_or ((';' | '&') and_or)* [';' | '&']
+ *   and_or  := command (('&&' | '||') command)*
+ *   command := word+
+ * Words may be quoted: '...' is literal, "..." honours \" \\ \$ and \`,
+ * a backslash outside quotes escapes the next character. An unquoted #
+ * at the start of a word begins a comment.
+ *
+ * Everything, including the unquoted words, is allocated from arena and
+ * stays valid until it is reset. *tree is NULL for a blank line. Returns
+ * -1 after printing a message on a syntax error or when out of memory.
+ */
+int parse_line(const char* line, Arena* arena, AstNode** tree);
+
+#endif
@@ -0,0 +1,189 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pathcache.h"
+
+#define PATH_CACHE_INITIAL_CAPACITY 64
+
+/* name and path share one allocation: name\0path\0. */
+typedef struct {
+    char* name;
+    const char* path;
+    size_t hits;
+} PathEntry;
+
+/* Open addressing with linear probing, kept at most half full. */
+static struct {
+    PathEntry* entries;
+    size_t capacity;
+    size_t count;
+    char* path_variable;
+} cache;
+
+/* Result of a lookup that is not remembered: a name found through a relative PATH entry. */
+static char uncached[PATH_MAX];
+
+static uint64_t hash_name(const char* name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*)name; *c; c++) {
+        hash = (hash ^ *c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static PathEntry* find_slot(PathEntry* entries, size_t capacity, const char* name) {
+    size_t index = (size_t)hash_name(name) & (capacity - 1);
+    while (entries[index].name && strcmp(entries[index].name, name) != 0) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &entries[index];
+}
+
+void path_cache_clear(void) {
+    for (size_t i = 0; i < cache.capacity; i++) {
+        free(cache.entries[i].name);
+    }
+    free(cache.entries);
+    free(cache.path_variable);
+    memset(&cache, 0, sizeof(cache));
+}
+
+static int grow(void) {
+    size_t capacity = cache.capacity ? cache.capacity * 2 : PATH_CACHE_INITIAL_CAPACITY;
+    PathEntry* entries = calloc(capacity, sizeof(PathEntry));
+    if (!entries) {
+        return -1;
+    }
+    for (size_t i = 0; i < cache.capacity; i++) {
+        if (cache.entries[i].name) {
+            *find_slot(entries, capacity, cache.entries[i].name) = cache.entries[i];
+        }
+    }
+    free(cache.entries);
+    cache.entries = entries;
+    cache.capacity = capacity;
+    return 0;
+}
+
+/* Removal re-inserts the rest of the probe chain so later lookups do not stop at the hole. */
+static void remove_entry(PathEntry* entry) {
+    size_t index = (size_t)(entry - cache.entries);
+    free(entry->name);
+    entry->name = NULL;
+    cache.count--;
+    for (index = (index + 1) & (cache.capacity - 1); cache.entries[index].name;
+         index = (index + 1) & (cache.capacity - 1)) {
+        PathEntry moved = cache.entries[index];
+        cache.entries[index].name = NULL;
+        *find_slot(cache.entries, cache.capacity, moved.name) = moved;
+    }
+}
+
+static int is_executable(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISREG(info.st_mode) && access(path, X_OK) == 0;
+}
+
+/* Walks PATH like execvp: an empty entry is the current directory. */
+static int search_path(const char* path_variable, const char* name, char* found, int* relative) {
+    size_t name_length = strlen(name);
+    const char* dir = path_variable;
+    for (;;) {
+        const char* end = strchr(dir, ':');
+        size_t dir_length = end ? (size_t)(end - dir) : strlen(dir);
+        if (dir_length == 0) {
+            dir = ".";
+            dir_length = 1;
+        }
+        if (dir_length + 1 + name_length < PATH_MAX) {
+            memcpy(found, dir, dir_length);
+            found[dir_length] = '/';
+            memcpy(found + dir_length + 1, name, name_length + 1);
+            if (is_executable(found)) {
+                *relative = found[0] != '/';
+                return 0;
+            }
+        }
+        if (!end) {
+            return -1;
+        }
+        dir = end + 1;
+    }
+}
+
+const char* path_cache_lookup(const char* name) {
+    if (strchr(name, '/')) {
+        return name;
+    }
+    const char* path_variable = getenv("PATH");
+    if (!path_variable) {
+        path_variable = "/bin:/usr/bin";
+    }
+    if (cache.path_variable && strcmp(cache.path_variable, path_variable) != 0) {
+        path_cache_clear();
+    }
+
+    if (cache.count > 0) {
+        PathEntry* entry = find_slot(cache.entries, cache.capacity, name);
+        if (entry->name) {
+            entry->hits++;
+            return entry->path;
+        }
+    }
+
+    char found[PATH_MAX];
+    int relative;
+    if (search_path(path_variable, name, found, &relative) != 0) {
+        return NULL;
+    }
+    /* ./name depends on the working directory, so it is looked up every time. */
+    if (relative) {
+        strcpy(uncached, found);
+        return uncached;
+    }
+
+    if (!cache.path_variable && !(cache.path_variable = strdup(path_variable))) {
+        strcpy(uncached, found);
+        return uncached;
+    }
+    size_t name_size = strlen(name) + 1;
+    char* block = malloc(name_size + strlen(found) + 1);
+    if (!block || (2 * (cache.count + 1) > cache.capacity && grow() != 0)) {
+        free(block);
+        strcpy(uncached, found);
+        return uncached;
+    }
+    memcpy(block, name, name_size);
+    strcpy(block + name_size, found);
+    PathEntry* entry = find_slot(cache.entries, cache.capacity, name);
+    entry->name = block;
+    entry->path = block + name_size;
+    entry->hits = 1;
+    cache.count++;
+    return entry->path;
+}
+
+void path_cache_check(const char* name) {
+    if (cache.count == 0) {
+        return;
+    }
+    PathEntry* entry = find_slot(cache.entries, cache.capacity, name);
+    if (entry->name && !is_executable(entry->path)) {
+        remove_entry(entry);
+    }
+}
+
+void path_cache_foreach(void (*visit)(const char* name, const char* path, size_t hits, void* arg), void* arg) {
+    for (size_t i = 0; i < cache.capacity; i++) {
+        if (cache.entries[i].name) {
+            visit(cache.entries[i].name, cache.entries[i].path, cache.entries[i].hits, arg);
+        }
+    }
+}
+
+size_t path_cache_size(void) {
+    return cache.count;
+}
@@ -0,0 +1,30 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <stddef.h>
+
+/*
+ * Remembers where PATH lookups found each command, like the hash builtin
+ * of sh, so a script running the same commands over and over does not
+ * stat every PATH directory each time. The table is emptied whenever PATH
+ * differs from the value it was filled with.
+ */
+
+/*
+ * Returns the file a command name runs: the name itself when it contains a
+ * slash, else the first executable regular file in PATH, or NULL when there
+ * is none. The string is valid until the next call that changes the table.
+ */
+const char* path_cache_lookup(const char* name);
+
+/* Drops name when its remembered file no longer exists or cannot be executed. */
+void path_cache_check(const char* name);
+
+void path_cache_clear(void);
+
+/* Calls visit for every remembered command, with how often it was looked up. */
+void path_cache_foreach(void (*visit)(const char* name, const char* path, size_t hits, void* arg), void* arg);
+
+size_t path_cache_size(void);
+
+#endif
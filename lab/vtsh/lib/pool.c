@@ -0,0 +1,322 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+/* A range is split in halves until this many pieces per thread exist. */
+#define POOL_SPLITS_PER_THREAD 8
+/* Halving from any size_t range never needs more slots than this. */
+#define DEQUE_CAPACITY 64
+
+typedef struct {
+    size_t begin;
+    size_t end;
+} Range;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Range items[DEQUE_CAPACITY];
+    size_t head;
+    size_t count;
+} Deque;
+
+typedef struct {
+    PoolTask task;
+    void* arg;
+    size_t grain;
+    int limit;
+    atomic_size_t remaining;
+    /* Bumped on every split so idle workers know to look again. */
+    atomic_ulong pushes;
+    atomic_int idle;
+} Job;
+
+typedef struct {
+    int size;
+    pthread_t* threads;
+    Deque* deques;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    pthread_cond_t work;
+    pthread_mutex_t submit;
+    Job* job;
+    unsigned long generation;
+    int active;
+} Pool;
+
+static Pool pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .submit = PTHREAD_MUTEX_INITIALIZER,
+};
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static bool pool_atfork_registered;
+
+int pool_default_threads(void) {
+    const char* env = getenv("VTSH_THREADS");
+    if (env && *env) {
+        char* endptr;
+        long threads = strtol(env, &endptr, 10);
+        if (*endptr == '\0' && threads >= 1) {
+            return threads > POOL_MAX_THREADS ? POOL_MAX_THREADS : (int)threads;
+        }
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        return 1;
+    }
+    return cpus > POOL_MAX_THREADS ? POOL_MAX_THREADS : (int)cpus;
+}
+
+static bool deque_push(Deque* deque, Range range) {
+    bool pushed = false;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count < DEQUE_CAPACITY) {
+        deque->items[(deque->head + deque->count) % DEQUE_CAPACITY] = range;
+        deque->count++;
+        pushed = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return pushed;
+}
+
+/* The owner takes the newest, smallest range from the bottom. */
+static bool deque_pop(Deque* deque, Range* range) {
+    bool popped = false;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        deque->count--;
+        *range = deque->items[(deque->head + deque->count) % DEQUE_CAPACITY];
+        popped = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return popped;
+}
+
+/* Thieves take the oldest, largest range from the top. */
+static bool deque_steal(Deque* deque, Range* range) {
+    bool stolen = false;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        *range = deque->items[deque->head];
+        deque->head = (deque->head + 1) % DEQUE_CAPACITY;
+        deque->count--;
+        stolen = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return stolen;
+}
+
+static void wake_idle(Job* job) {
+    if (atomic_load(&job->idle) > 0) {
+        pthread_mutex_lock(&pool.lock);
+        pthread_cond_broadcast(&pool.work);
+        pthread_mutex_unlock(&pool.lock);
+    }
+}
+
+static void run_range(Job* job, Deque* own, Range range) {
+    bool pushed = false;
+    while (range.end - range.begin > job->grain) {
+        size_t middle = range.begin + (range.end - range.begin) / 2;
+        if (!deque_push(own, (Range){middle, range.end})) {
+            break;
+        }
+        range.end = middle;
+        pushed = true;
+    }
+    if (pushed) {
+        atomic_fetch_add(&job->pushes, 1);
+        wake_idle(job);
+    }
+    for (size_t i = range.begin; i < range.end; i++) {
+        job->task(job->arg, i);
+    }
+    size_t count = range.end - range.begin;
+    if (atomic_fetch_sub(&job->remaining, count) == count) {
+        wake_idle(job);
+    }
+}
+
+/*
+ * Sleeps until another worker splits a range or the job finishes. The
+ * counters are read after `idle` is raised, so a pusher either sees the
+ * sleeper or the sleeper sees the push.
+ */
+static void wait_for_work(Job* job, unsigned long seen) {
+    pthread_mutex_lock(&pool.lock);
+    atomic_fetch_add(&job->idle, 1);
+    while (atomic_load(&job->pushes) == seen && atomic_load(&job->remaining) > 0) {
+        pthread_cond_wait(&pool.work, &pool.lock);
+    }
+    atomic_fetch_sub(&job->idle, 1);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+static void run_job(Job* job, int id) {
+    Deque* own = &pool.deques[id];
+    while (atomic_load(&job->remaining) > 0) {
+        unsigned long seen = atomic_load(&job->pushes);
+        Range range;
+        if (deque_pop(own, &range)) {
+            run_range(job, own, range);
+            continue;
+        }
+
+        bool stolen = false;
+        for (int offset = 1; offset < job->limit && !stolen; offset++) {
+            stolen = deque_steal(&pool.deques[(id + offset) % job->limit], &range);
+        }
+        if (stolen) {
+            run_range(job, own, range);
+        } else {
+            /* Everything left is already running elsewhere. */
+            wait_for_work(job, seen);
+        }
+    }
+}
+
+static void* worker_main(void* arg) {
+    int id = (int)(intptr_t)arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.generation == seen || !pool.job) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        seen = pool.generation;
+        Job* job = pool.job;
+        if (id >= job->limit) {
+            continue;
+        }
+        pool.active++;
+        pthread_mutex_unlock(&pool.lock);
+
+        run_job(job, id);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.active == 0) {
+            pthread_cond_signal(&pool.done);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * A forked child has none of the workers, and locks they held at the fork
+ * stay locked. The child drops the inherited pool and starts its own on
+ * first use.
+ */
+static void pool_reset_child(void) {
+    free(pool.threads);
+    free(pool.deques);
+    pool = (Pool){
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .wake = PTHREAD_COND_INITIALIZER,
+        .done = PTHREAD_COND_INITIALIZER,
+        .work = PTHREAD_COND_INITIALIZER,
+        .submit = PTHREAD_MUTEX_INITIALIZER,
+    };
+    pool_once = (pthread_once_t)PTHREAD_ONCE_INIT;
+}
+
+static void pool_start(void) {
+    if (!pool_atfork_registered) {
+        pool_atfork_registered = pthread_atfork(NULL, NULL, pool_reset_child) == 0;
+    }
+
+    int size = pool_default_threads();
+    pool.threads = calloc((size_t)size, sizeof(pthread_t));
+    pool.deques = calloc((size_t)size, sizeof(Deque));
+    if (!pool.threads || !pool.deques) {
+        free(pool.threads);
+        free(pool.deques);
+        pool.threads = NULL;
+        pool.deques = NULL;
+        pool.size = 1;
+        return;
+    }
+    for (int i = 0; i < size; i++) {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+    }
+
+    /* A worker that cannot be created just shrinks the pool. */
+    pool.size = 1;
+    while (pool.size < size &&
+           pthread_create(&pool.threads[pool.size], NULL, worker_main, (void*)(intptr_t)pool.size) == 0) {
+        pool.size++;
+    }
+}
+
+static void run_inline(size_t count, PoolTask task, void* arg) {
+    for (size_t i = 0; i < count; i++) {
+        task(arg, i);
+    }
+}
+
+void pool_parallel_for(size_t count, int threads, PoolTask task, void* arg) {
+    if (threads <= 1 || count <= 1) {
+        run_inline(count, task, arg);
+        return;
+    }
+    pthread_once(&pool_once, pool_start);
+    if (pool.size <= 1) {
+        run_inline(count, task, arg);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.submit);
+
+    Job job;
+    job.task = task;
+    job.arg = arg;
+    job.limit = threads < pool.size ? threads : pool.size;
+    if ((size_t)job.limit > count) {
+        job.limit = (int)count;
+    }
+    job.grain = count / ((size_t)job.limit * POOL_SPLITS_PER_THREAD);
+    if (job.grain == 0) {
+        job.grain = 1;
+    }
+    atomic_init(&job.remaining, count);
+    atomic_init(&job.pushes, 0);
+    atomic_init(&job.idle, 0);
+
+    for (int i = 0; i < job.limit; i++) {
+        size_t begin = count * (size_t)i / (size_t)job.limit;
+        size_t end = count * (size_t)(i + 1) / (size_t)job.limit;
+        deque_push(&pool.deques[i], (Range){begin, end});
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.job = &job;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_job(&job, 0);
+
+    /* Workers may still hold a pointer to the job until they check in. */
+    pthread_mutex_lock(&pool.lock);
+    pool.job = NULL;
+    while (pool.active > 0) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    pthread_mutex_unlock(&pool.submit);
+}
+
+unsigned long pool_jobs_dispatched(void) {
+    pthread_mutex_lock(&pool.lock);
+    unsigned long jobs = pool.generation;
+    pthread_mutex_unlock(&pool.lock);
+    return jobs;
+}
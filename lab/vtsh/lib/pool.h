@@ -0,0 +1,30 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#define POOL_MAX_THREADS 256
+
+/*
+ * Process-wide work-stealing pool. Workers are started on the first
+ * parallel job, one per online CPU unless VTSH_THREADS says otherwise;
+ * the submitting thread takes part as worker 0. Every worker owns a deque
+ * of index ranges: it splits and pops ranges at the bottom while idle
+ * workers steal the largest ranges from the top of the others' deques.
+ */
+typedef void (*PoolTask)(void* arg, size_t index);
+
+/* Number of threads a job may use: VTSH_THREADS if set, else the online CPUs. */
+int pool_default_threads(void);
+
+/*
+ * Runs task(arg, i) for every i in [0, count) on at most `threads`
+ * threads and returns once all of them finished. Jobs from different
+ * threads are serialized; a task must not submit a job itself.
+ */
+void pool_parallel_for(size_t count, int threads, PoolTask task, void* arg);
+
+/* Number of jobs so far that were handed to the workers rather than run inline. */
+unsigned long pool_jobs_dispatched(void);
+
+#endif
@@ -0,0 +1,176 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "process.h"
+
+/* Stack of a clone3 child until it execs. */
+#define SPAWN_STACK_SIZE (64 * 1024)
+
+extern char** environ;
+
+static const char* backend_names[SPAWN_BACKEND_COUNT] = {"fork", "vfork", "clone3", "posix_spawn"};
+
+const char* spawn_backend_name(SpawnBackend backend) {
+    return backend_names[backend];
+}
+
+int spawn_backend_parse(const char* name, SpawnBackend* backend) {
+    for (int i = 0; i < SPAWN_BACKEND_COUNT; i++) {
+        if (strcmp(name, backend_names[i]) == 0) {
+            *backend = (SpawnBackend)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * State shared with a child that runs in our address space. The shell is
+ * suspended until the child execs or exits, so error is safe to read after.
+ */
+typedef struct {
+    const char* path;
+    char* const* args;
+    const sigset_t* mask;
+    int error;
+} SharedChild;
+
+/* Runs in the child of vfork or clone3: it may only touch its own stack and child. */
+static int exec_shared(void* arg) {
+    SharedChild* child = arg;
+    sigprocmask(SIG_SETMASK, child->mask, NULL);
+    execve(child->path, child->args, environ);
+    child->error = errno;
+    _exit(SPAWN_EXEC_FAILED);
+}
+
+static pid_t spawn_fork(const char* path, char* const args[]) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execve(path, args, environ);
+        perror("exec failed");
+        _exit(SPAWN_EXEC_FAILED);
+    }
+    return pid;
+}
+
+static pid_t spawn_vfork(SharedChild* child) {
+    pid_t pid = vfork();
+    if (pid == 0) {
+        exec_shared(child);
+    }
+    return pid;
+}
+
+#ifdef __x86_64__
+/*
+ * clone3 has no glibc wrapper, and a child that shares our memory cannot
+ * return from a syscall() call into C code, so it is entered here: it starts
+ * on the new stack, calls fn(arg) and exits with its result.
+ */
+static long raw_clone3(struct clone_args* clone_args, int (*fn)(void*), void* arg) {
+    register long rax __asm__("rax") = SYS_clone3;
+    register struct clone_args* rdi __asm__("rdi") = clone_args;
+    register size_t rsi __asm__("rsi") = sizeof(*clone_args);
+    register int (*r12)(void*) __asm__("r12") = fn;
+    register void* r13 __asm__("r13") = arg;
+    __asm__ volatile("syscall\n\t"
+                     "test %%rax, %%rax\n\t"
+                     "jnz 1f\n\t"
+                     "xor %%ebp, %%ebp\n\t"
+                     "mov %%r13, %%rdi\n\t"
+                     "call *%%r12\n\t"
+                     "mov %%eax, %%edi\n\t"
+                     "mov %[exit_nr], %%eax\n\t"
+                     "syscall\n\t"
+                     "hlt\n"
+                     "1:\n\t"
+                     : "+r"(rax)
+                     : "r"(rdi), "r"(rsi), "r"(r12), "r"(r13), [exit_nr] "i"(SYS_exit)
+                     : "rcx", "r11", "memory");
+    return rax;
+}
+#endif
+
+/*
+ * clone3(CLONE_VM | CLONE_VFORK) on a stack of its own. Kernels or seccomp
+ * profiles without clone3 answer ENOSYS; clone(2) with the same flags is
+ * used from then on, as it is on other architectures.
+ */
+static pid_t spawn_clone3(SharedChild* child) {
+    static int clone3_missing;
+    size_t stack_size = SPAWN_STACK_SIZE;
+    void* stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+        return -1;
+    }
+
+    long pid = -ENOSYS;
+#ifdef __x86_64__
+    if (!clone3_missing) {
+        struct clone_args clone_args;
+        memset(&clone_args, 0, sizeof(clone_args));
+        clone_args.flags = CLONE_VM | CLONE_VFORK;
+        clone_args.exit_signal = SIGCHLD;
+        clone_args.stack = (uint64_t)(uintptr_t)stack;
+        clone_args.stack_size = stack_size;
+        pid = raw_clone3(&clone_args, exec_shared, child);
+    }
+#endif
+    if (pid == -ENOSYS) {
+        clone3_missing = 1;
+        pid = clone(exec_shared, (char*)stack + stack_size, CLONE_VM | CLONE_VFORK | SIGCHLD, child);
+    } else if (pid < 0) {
+        errno = (int)-pid;
+        pid = -1;
+    }
+    munmap(stack, stack_size);
+    return (pid_t)pid;
+}
+
+pid_t spawn_process(SpawnBackend backend, const char* path, char* const args[]) {
+    if (backend == SPAWN_FORK) {
+        pid_t pid = spawn_fork(path, args);
+        if (pid < 0) {
+            perror("fork failed");
+        }
+        return pid;
+    }
+
+    if (backend == SPAWN_POSIX_SPAWN) {
+        pid_t pid;
+        int error = posix_spawn(&pid, path, NULL, NULL, args, environ);
+        if (error != 0) {
+            /* glibc reports exec failures here and has already reaped the child. */
+            fprintf(stderr, "exec failed: %s\n", strerror(error));
+            return -1;
+        }
+        return pid;
+    }
+
+    /* No signal handler may run in a child that shares our memory. */
+    sigset_t all, saved;
+    sigfillset(&all);
+    sigprocmask(SIG_BLOCK, &all, &saved);
+    SharedChild child = {path, args, &saved, 0};
+    pid_t pid = backend == SPAWN_VFORK ? spawn_vfork(&child) : spawn_clone3(&child);
+    int error = errno;
+    sigprocmask(SIG_SETMASK, &saved, NULL);
+
+    if (pid < 0) {
+        fprintf(stderr, "%s failed: %s\n", spawn_backend_name(backend), strerror(error));
+    } else if (child.error != 0) {
+        fprintf(stderr, "exec failed: %s\n", strerror(child.error));
+    }
+    return pid;
+}
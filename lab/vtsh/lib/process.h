@@ -0,0 +1,36 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <sys/types.h>
+
+/* Exit status of a command that could not be executed, as in sh. */
+#define SPAWN_EXEC_FAILED 127
+
+/*
+ * How a child process is created. fork copies the page tables, so its cost
+ * grows with the shell's RSS; the others share the address space with the
+ * child until it execs, suspending the shell meanwhile.
+ */
+typedef enum {
+    SPAWN_FORK,
+    SPAWN_VFORK,
+    SPAWN_CLONE3,
+    SPAWN_POSIX_SPAWN,
+    SPAWN_BACKEND_COUNT
+} SpawnBackend;
+
+const char* spawn_backend_name(SpawnBackend backend);
+
+/* Looks a backend up by its name; returns -1 for an unknown one. */
+int spawn_backend_parse(const char* name, SpawnBackend* backend);
+
+/*
+ * Executes path, already resolved (see pathcache.h), with args in a child
+ * that inherits the shell's descriptors and environment. Returns the
+ * child's pid, to be collected with waitpid. A failed exec is reported on
+ * stderr; the child, if one is left, then exits with SPAWN_EXEC_FAILED.
+ * Returns -1 when no child is left to wait for.
+ */
+pid_t spawn_process(SpawnBackend backend, const char* path, char* const args[]);
+
+#endif
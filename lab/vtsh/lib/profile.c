@@ -0,0 +1,176 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include "pool.h"
+#include "profile.h"
+
+typedef struct {
+    uint32_t type;
+    uint64_t config;
+    const char* name;
+} CounterEvent;
+
+static const CounterEvent hardware_events[PROFILE_MAX_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses"},
+};
+
+static const CounterEvent software_events[] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task-clock ns"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "cpu-migrations"},
+};
+
+static struct {
+    int count;
+    int fds[PROFILE_MAX_COUNTERS];
+    const char* names[PROFILE_MAX_COUNTERS];
+} counters;
+
+static int open_counter(const CounterEvent* event) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event->type;
+    attr.config = event->config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    /* Kernel counting needs perf_event_paranoid below 2, user space only does not. */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd >= 0) {
+        counters.fds[counters.count] = fd;
+        counters.names[counters.count] = event->name;
+        counters.count++;
+    }
+    return fd;
+}
+
+int profile_open_counters(void) {
+    profile_close_counters();
+    for (size_t i = 0; i < sizeof(hardware_events) / sizeof(hardware_events[0]); i++) {
+        open_counter(&hardware_events[i]);
+    }
+    if (counters.count == 0) {
+        for (size_t i = 0; i < sizeof(software_events) / sizeof(software_events[0]); i++) {
+            open_counter(&software_events[i]);
+        }
+    }
+    return counters.count > 0 ? 0 : -1;
+}
+
+void profile_close_counters(void) {
+    for (int i = 0; i < counters.count; i++) {
+        close(counters.fds[i]);
+    }
+    counters.count = 0;
+}
+
+/* Reads value, time enabled and time running. */
+static void read_counter(int fd, uint64_t values[3]) {
+    if (read(fd, values, 3 * sizeof(uint64_t)) != (ssize_t)(3 * sizeof(uint64_t))) {
+        memset(values, 0, 3 * sizeof(uint64_t));
+    }
+}
+
+/*
+ * A reset clears the shell's own count but not what exited children have
+ * already merged in, so a command's share is the difference of two reads.
+ * Multiplexed counters only ran part of the time and are scaled up.
+ */
+static uint64_t counter_delta(const uint64_t before[3], const uint64_t after[3]) {
+    uint64_t value = after[0] - before[0];
+    uint64_t enabled = after[1] - before[1];
+    uint64_t running = after[2] - before[2];
+    if (running == 0) {
+        return 0;
+    }
+    if (running < enabled) {
+        return (uint64_t)((double)value * ((double)enabled / (double)running));
+    }
+    return value;
+}
+
+static double timeval_ms(const struct timeval* time) {
+    return (double)time->tv_sec * 1000.0 + (double)time->tv_usec / 1000.0;
+}
+
+void profile_begin(ProfileScope* scope) {
+    for (int i = 0; i < counters.count; i++) {
+        read_counter(counters.fds[i], scope->counters[i]);
+        ioctl(counters.fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    getrusage(RUSAGE_SELF, &scope->usage);
+    scope->pool_jobs = pool_jobs_dispatched();
+    clock_gettime(CLOCK_MONOTONIC, &scope->start);
+}
+
+void profile_end(ProfileScope* scope, const struct rusage* child, CommandProfile* profile) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (int i = 0; i < counters.count; i++) {
+        ioctl(counters.fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    profile->wall_ms = (double)(end.tv_sec - scope->start.tv_sec) * 1000.0 +
+                       (double)(end.tv_nsec - scope->start.tv_nsec) / 1000000.0;
+    if (child) {
+        profile->user_ms = timeval_ms(&child->ru_utime);
+        profile->system_ms = timeval_ms(&child->ru_stime);
+        profile->voluntary_switches = child->ru_nvcsw;
+        profile->involuntary_switches = child->ru_nivcsw;
+        profile->minor_faults = child->ru_minflt;
+        profile->major_faults = child->ru_majflt;
+        profile->max_rss_kb = child->ru_maxrss;
+    } else {
+        struct rusage now;
+        const struct rusage* before = &scope->usage;
+        getrusage(RUSAGE_SELF, &now);
+        profile->user_ms = timeval_ms(&now.ru_utime) - timeval_ms(&before->ru_utime);
+        profile->system_ms = timeval_ms(&now.ru_stime) - timeval_ms(&before->ru_stime);
+        profile->voluntary_switches = now.ru_nvcsw - before->ru_nvcsw;
+        profile->involuntary_switches = now.ru_nivcsw - before->ru_nivcsw;
+        profile->minor_faults = now.ru_minflt - before->ru_minflt;
+        profile->major_faults = now.ru_majflt - before->ru_majflt;
+        profile->max_rss_kb = now.ru_maxrss;
+    }
+
+    profile->counter_count = counters.count;
+    if (!child && pool_jobs_dispatched() != scope->pool_jobs) {
+        profile->counter_count = 0;
+    }
+    for (int i = 0; i < counters.count; i++) {
+        uint64_t values[3];
+        read_counter(counters.fds[i], values);
+        profile->counter_names[i] = counters.names[i];
+        profile->counters[i] = counter_delta(scope->counters[i], values);
+    }
+}
+
+void profile_print(const CommandProfile* profile) {
+    printf("  cpu: %.3f ms user, %.3f ms sys\n", profile->user_ms, profile->system_ms);
+    printf("  context switches: %ld voluntary, %ld involuntary\n", profile->voluntary_switches,
+           profile->involuntary_switches);
+    printf("  page faults: %ld minor, %ld major; max rss: %ld KiB\n", profile->minor_faults, profile->major_faults,
+           profile->max_rss_kb);
+    if (profile->counter_count == 0) {
+        return;
+    }
+    printf("  counters:");
+    for (int i = 0; i < profile->counter_count; i++) {
+        printf("%s %llu %s", i > 0 ? "," : "", (unsigned long long)profile->counters[i], profile->counter_names[i]);
+    }
+    if (profile->counter_count >= 2 && strcmp(profile->counter_names[0], "cycles") == 0 &&
+        strcmp(profile->counter_names[1], "instructions") == 0 && profile->counters[0] > 0) {
+        printf(" (%.2f IPC)", (double)profile->counters[1] / (double)profile->counters[0]);
+    }
+    printf("\n");
+}
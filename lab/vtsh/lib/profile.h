@@ -0,0 +1,57 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define PROFILE_MAX_COUNTERS 3
+
+/* Resources one command used; counters holds whichever perf events could be opened. */
+typedef struct {
+    double wall_ms;
+    double user_ms;
+    double system_ms;
+    long voluntary_switches;
+    long involuntary_switches;
+    long minor_faults;
+    long major_faults;
+    long max_rss_kb;
+    int counter_count;
+    const char* counter_names[PROFILE_MAX_COUNTERS];
+    uint64_t counters[PROFILE_MAX_COUNTERS];
+} CommandProfile;
+
+/* State kept between profile_begin and profile_end. */
+typedef struct {
+    struct timespec start;
+    struct rusage usage;
+    uint64_t counters[PROFILE_MAX_COUNTERS][3];
+    unsigned long pool_jobs;
+} ProfileScope;
+
+/*
+ * Opens user-space cycles, instructions and cache-misses counters for the
+ * shell, inherited by the children it starts. Where the hardware has none
+ * (typically in a VM) task-clock and cpu-migrations are opened instead.
+ * Returns -1 when perf_event_open is not permitted at all.
+ */
+int profile_open_counters(void);
+void profile_close_counters(void);
+
+/* Starts measuring the next command and takes the counters' baseline. */
+void profile_begin(ProfileScope* scope);
+
+/*
+ * Fills profile for the command started by profile_begin. child is the
+ * wait4 usage of an external command; NULL means a builtin, measured by
+ * RUSAGE_SELF deltas so the pool workers are included, with max_rss_kb
+ * being the shell's own peak. Counters of threads are merged only when
+ * they exit and the pool workers never do, so a builtin that ran jobs on
+ * the pool reports no counters rather than the calling thread's share.
+ */
+void profile_end(ProfileScope* scope, const struct rusage* child, CommandProfile* profile);
+
+void profile_print(const CommandProfile* profile);
+
+#endif
@@ -0,0 +1,337 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "join.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define READ_CHUNK_SIZE (1024 * 1024)
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static void skip_spaces(TableReader* reader) {
+    while (reader->pos < reader->size && is_space(reader->data[reader->pos])) {
+        reader->pos++;
+    }
+}
+
+/* Pipes and other unmappable inputs are slurped into the heap instead. */
+static int read_whole_file(TableReader* reader, int fd) {
+    size_t capacity = 0;
+    char* data = NULL;
+    reader->size = 0;
+    for (;;) {
+        if (reader->size == capacity) {
+            capacity = capacity ? capacity * 2 : READ_CHUNK_SIZE;
+            char* grown = realloc(data, capacity);
+            if (!grown) {
+                free(data);
+                return -1;
+            }
+            data = grown;
+        }
+        ssize_t n = read(fd, data + reader->size, capacity - reader->size);
+        if (n < 0) {
+            free(data);
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        reader->size += (size_t)n;
+    }
+    reader->data = data;
+    reader->mapped = false;
+    return 0;
+}
+
+/* Parses an optionally signed decimal int, rejecting anything that overflows. */
+static int parse_id(TableReader* reader, int* id) {
+    const char* data = reader->data;
+    size_t pos = reader->pos;
+    bool negative = false;
+    if (pos < reader->size && (data[pos] == '-' || data[pos] == '+')) {
+        negative = data[pos] == '-';
+        pos++;
+    }
+
+    size_t digits_start = pos;
+    long long value = 0;
+    while (pos < reader->size && data[pos] >= '0' && data[pos] <= '9') {
+        value = value * 10 + (data[pos] - '0');
+        if (value > (long long)INT_MAX + 1) {
+            return -1;
+        }
+        pos++;
+    }
+    if (pos == digits_start || (!negative && value > INT_MAX)) {
+        return -1;
+    }
+
+    *id = (int)(negative ? -value : value);
+    reader->pos = pos;
+    return 0;
+}
+
+/*
+ * Length of the whitespace-free word at pos. Rows are fixed width, so one
+ * 16-byte compare usually finds the terminator right after the 8th byte.
+ */
+static size_t word_length(const TableReader* reader) {
+    const char* start = reader->data + reader->pos;
+    size_t available = reader->size - reader->pos;
+    size_t length = 0;
+#ifdef __SSE2__
+    while (available - length >= 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(start + length));
+        /* Whitespace is ' ' or one of the control bytes '\t'..'\r'. */
+        __m128i space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+        __m128i control = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('\t' - 1)),
+                                        _mm_cmplt_epi8(bytes, _mm_set1_epi8('\r' + 1)));
+        int mask = _mm_movemask_epi8(_mm_or_si128(space, control));
+        if (mask != 0) {
+            return length + (size_t)__builtin_ctz((unsigned)mask);
+        }
+        length += 16;
+    }
+#endif
+    while (length < available && !is_space(start[length])) {
+        length++;
+    }
+    return length;
+}
+
+static int open_binary(TableReader* reader) {
+    TableHeader header;
+    memcpy(&header, reader->data, sizeof(header));
+    if (header.version != TABLE_BINARY_VERSION) {
+        fprintf(stderr, "Unsupported binary format version %u in %s\n", header.version, reader->name);
+        return -1;
+    }
+    if (header.count > INT_MAX) {
+        fprintf(stderr, "Error reading %s size\n", reader->name);
+        return -1;
+    }
+    size_t columns = (size_t)header.count * (sizeof(int32_t) + JOIN_WORD_LENGTH);
+    if (reader->size - sizeof(header) < columns) {
+        fprintf(stderr, "Error reading %s: binary table truncated, expected %llu rows\n",
+                reader->name, (unsigned long long)header.count);
+        return -1;
+    }
+
+    reader->binary = true;
+    reader->sorted = (header.flags & TABLE_BINARY_SORTED) != 0;
+    reader->count = (int)header.count;
+    reader->ids = (const int32_t*)(reader->data + sizeof(header));
+    reader->words = reader->data + sizeof(header) + (size_t)header.count * sizeof(int32_t);
+    return 0;
+}
+
+int table_reader_open(TableReader* reader, FILE* file, const char* name) {
+    memset(reader, 0, sizeof(*reader));
+    reader->name = name;
+
+    int fd = fileno(file);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+            reader->data = data;
+            reader->size = (size_t)st.st_size;
+            reader->mapped = true;
+        }
+    }
+    if (!reader->data && read_whole_file(reader, fd) != 0) {
+        fprintf(stderr, "Error reading %s\n", name);
+        return -1;
+    }
+
+    if (reader->size >= sizeof(TableHeader) && memcmp(reader->data, TABLE_BINARY_MAGIC, 4) == 0) {
+        if (open_binary(reader) != 0) {
+            table_reader_close(reader);
+            return -1;
+        }
+        return 0;
+    }
+
+    skip_spaces(reader);
+    int count;
+    if (parse_id(reader, &count) != 0 || count < 0) {
+        fprintf(stderr, "Error reading %s size\n", name);
+        table_reader_close(reader);
+        return -1;
+    }
+    reader->count = count;
+    return 0;
+}
+
+static void binary_row(const TableReader* reader, int index, Row* row) {
+    row->id = reader->ids[index];
+    memcpy(row->word, reader->words + (size_t)index * JOIN_WORD_LENGTH, JOIN_WORD_LENGTH);
+    row->word[JOIN_WORD_LENGTH] = '\0';
+}
+
+int table_reader_next(TableReader* reader, Row* row) {
+    int index = reader->index;
+    if (reader->binary) {
+        if (index >= reader->count) {
+            fprintf(stderr, "Error reading %s at row %d: past the end of the table\n", reader->name, index);
+            return -1;
+        }
+        binary_row(reader, index, row);
+        reader->index++;
+        return 0;
+    }
+
+    skip_spaces(reader);
+    if (reader->pos >= reader->size) {
+        fprintf(stderr, "Error reading %s at row %d: unexpected end of file, expected %d rows\n",
+                reader->name, index, reader->count);
+        return -1;
+    }
+    if (parse_id(reader, &row->id) != 0) {
+        fprintf(stderr, "Error reading %s at row %d: invalid id\n", reader->name, index);
+        return -1;
+    }
+    if (reader->pos < reader->size && !is_space(reader->data[reader->pos])) {
+        fprintf(stderr, "Error reading %s at row %d: invalid id\n", reader->name, index);
+        return -1;
+    }
+
+    skip_spaces(reader);
+    size_t length = word_length(reader);
+    if (length == 0) {
+        fprintf(stderr, "Error reading %s at row %d: missing word\n", reader->name, index);
+        return -1;
+    }
+    if (length != JOIN_WORD_LENGTH) {
+        fprintf(stderr, "Invalid word length in %s at row %d: expected %d, got %zu\n",
+                reader->name, index, JOIN_WORD_LENGTH, length);
+        return -1;
+    }
+    memcpy(row->word, reader->data + reader->pos, JOIN_WORD_LENGTH);
+    row->word[JOIN_WORD_LENGTH] = '\0';
+    reader->pos += JOIN_WORD_LENGTH;
+    reader->index++;
+    return 0;
+}
+
+void table_reader_close(TableReader* reader) {
+    if (reader->mapped) {
+        munmap((void*)reader->data, reader->size);
+    } else {
+        free((void*)reader->data);
+    }
+    reader->data = NULL;
+    reader->size = 0;
+    reader->mapped = false;
+}
+
+int table_load(FILE* file, const char* name, Table* table) {
+    TableReader reader;
+    table->rows = NULL;
+    table->count = 0;
+    if (table_reader_open(&reader, file, name) != 0) {
+        return -1;
+    }
+
+    table->rows = malloc((size_t)reader.count * sizeof(Row) + 1);
+    if (!table->rows) {
+        fprintf(stderr, "Memory allocation failed for %s\n", name);
+        table_reader_close(&reader);
+        return -1;
+    }
+
+    int status = 0;
+    if (reader.binary) {
+        for (int i = 0; i < reader.count; i++) {
+            binary_row(&reader, i, &table->rows[i]);
+        }
+    } else {
+        for (int i = 0; i < reader.count && status == 0; i++) {
+            status = table_reader_next(&reader, &table->rows[i]);
+        }
+    }
+    if (status == 0) {
+        table->count = reader.count;
+    }
+    table_reader_close(&reader);
+    return status;
+}
+
+int table_write_text(const Table* table, FILE* output) {
+    fprintf(output, "%d\n", table->count);
+    for (int i = 0; i < table->count; i++) {
+        fprintf(output, "%d %s\n", table->rows[i].id, table->rows[i].word);
+    }
+    return ferror(output) ? -1 : 0;
+}
+
+typedef struct {
+    int id;
+    int index;
+} SortKey;
+
+/* Ties are broken by position so duplicates keep their input order. */
+static int compare_keys(const void* left, const void* right) {
+    const SortKey* a = left;
+    const SortKey* b = right;
+    if (a->id != b->id) {
+        return (a->id > b->id) - (a->id < b->id);
+    }
+    return (a->index > b->index) - (a->index < b->index);
+}
+
+int table_write_binary(const Table* table, FILE* output, bool sorted) {
+    size_t count = (size_t)table->count;
+    int32_t* ids = malloc(count * sizeof(int32_t) + 1);
+    char* words = malloc(count * JOIN_WORD_LENGTH + 1);
+    SortKey* keys = sorted ? malloc(count * sizeof(SortKey) + 1) : NULL;
+    if (!ids || !words || (sorted && !keys)) {
+        fprintf(stderr, "Memory allocation failed for binary table\n");
+        free(ids);
+        free(words);
+        free(keys);
+        return -1;
+    }
+
+    if (sorted) {
+        for (size_t i = 0; i < count; i++) {
+            keys[i].id = table->rows[i].id;
+            keys[i].index = (int)i;
+        }
+        qsort(keys, count, sizeof(SortKey), compare_keys);
+    }
+    for (size_t i = 0; i < count; i++) {
+        const Row* row = &table->rows[sorted ? (size_t)keys[i].index : i];
+        ids[i] = row->id;
+        memcpy(words + i * JOIN_WORD_LENGTH, row->word, JOIN_WORD_LENGTH);
+    }
+
+    TableHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TABLE_BINARY_MAGIC, sizeof(header.magic));
+    header.version = TABLE_BINARY_VERSION;
+    header.flags = sorted ? TABLE_BINARY_SORTED : 0;
+    header.count = count;
+
+    int status = 0;
+    if (fwrite(&header, sizeof(header), 1, output) != 1 ||
+        fwrite(ids, sizeof(int32_t), count, output) != count ||
+        fwrite(words, JOIN_WORD_LENGTH, count, output) != count) {
+        status = -1;
+    }
+
+    free(ids);
+    free(words);
+    free(keys);
+    return status;
+}
@@ -0,0 +1,104 @@
+#include <math.h>
+#include "dist.h"
+
+/* Terms of the zeta sum computed exactly; the tail is integrated. */
+#define ZETA_EXACT_TERMS 1000000ULL
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rotl(uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->state[i] = splitmix64(&seed);
+    }
+}
+
+uint64_t rng_next(Rng* rng) {
+    uint64_t* s = rng->state;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+/* Lemire's multiply-shift reduction, rejecting the biased low region. */
+uint64_t rng_below(Rng* rng, uint64_t bound) {
+    if (bound == 0) {
+        return 0;
+    }
+
+    unsigned __int128 product = (unsigned __int128)rng_next(rng) * bound;
+    uint64_t low = (uint64_t)product;
+    if (low < bound) {
+        uint64_t threshold = -bound % bound;
+        while (low < threshold) {
+            product = (unsigned __int128)rng_next(rng) * bound;
+            low = (uint64_t)product;
+        }
+    }
+    return (uint64_t)(product >> 64);
+}
+
+double rng_double(Rng* rng) {
+    return (double)(rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+static double zeta(uint64_t items, double theta) {
+    uint64_t exact = items < ZETA_EXACT_TERMS ? items : ZETA_EXACT_TERMS;
+    double sum = 0.0;
+
+    for (uint64_t i = 1; i <= exact; i++) {
+        sum += pow((double)i, -theta);
+    }
+    if (items > exact) {
+        double exponent = 1.0 - theta;
+        sum += (pow((double)items + 0.5, exponent) - pow((double)exact + 0.5, exponent)) / exponent;
+    }
+    return sum;
+}
+
+/* Gray et al., "Quickly generating billion-record synthetic databases"; theta must lie in (0, 1). */
+void zipf_init(Zipf* zipf, uint64_t items, double theta) {
+    zipf->items = items;
+    zipf->theta = theta;
+    zipf->zetan = zeta(items, theta);
+    zipf->alpha = 1.0 / (1.0 - theta);
+    zipf->half_pow_theta = pow(0.5, theta);
+    zipf->eta = 0.0;
+    if (items > 2) {
+        zipf->eta = (1.0 - pow(2.0 / (double)items, 1.0 - theta)) / (1.0 - zeta(2, theta) / zipf->zetan);
+    }
+}
+
+uint64_t zipf_next(const Zipf* zipf, Rng* rng) {
+    if (zipf->items <= 1) {
+        return 0;
+    }
+
+    double u = rng_double(rng);
+    double uz = u * zipf->zetan;
+    if (uz < 1.0) {
+        return 0;
+    }
+    if (uz < 1.0 + zipf->half_pow_theta) {
+        return 1;
+    }
+
+    uint64_t item = (uint64_t)((double)zipf->items * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return item < zipf->items ? item : zipf->items - 1;
+}
@@ -0,0 +1,28 @@
+#ifndef DIST_H
+#define DIST_H
+
+#include <stdint.h>
+
+/* xoshiro256** generator: 64-bit output, reproducible from a single seed. */
+typedef struct {
+    uint64_t state[4];
+} Rng;
+
+typedef struct {
+    uint64_t items;
+    double theta;
+    double zetan;
+    double alpha;
+    double eta;
+    double half_pow_theta;
+} Zipf;
+
+void rng_seed(Rng* rng, uint64_t seed);
+uint64_t rng_next(Rng* rng);
+uint64_t rng_below(Rng* rng, uint64_t bound);
+double rng_double(Rng* rng);
+
+void zipf_init(Zipf* zipf, uint64_t items, double theta);
+uint64_t zipf_next(const Zipf* zipf, Rng* rng);
+
+#endif
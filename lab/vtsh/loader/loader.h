@@ -0,0 +1,103 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include "dist.h"
+#include "stats.h"
+
+#define ALIGNMENT 512
+
+typedef enum {
+    IO_STDIO,
+    IO_DIRECT,
+    IO_VTPC,
+} IoMode;
+
+typedef enum {
+    RW_READ,
+    RW_WRITE,
+    RW_MIX,
+} RwMode;
+
+typedef enum {
+    ACCESS_SEQUENTIAL,
+    ACCESS_RANDOM,
+    ACCESS_ZIPF,
+    ACCESS_HOTSPOT,
+    ACCESS_STRIDE,
+} AccessPattern;
+
+typedef struct {
+    const char* rw;
+    const char* type;
+    RwMode rw_mode;
+    AccessPattern pattern;
+    unsigned read_percent;
+    unsigned hot_ops_percent;
+    unsigned hot_data_percent;
+    size_t stride;
+    Zipf zipf;
+    size_t block_size;
+    size_t block_count;
+    size_t start_pos;
+    size_t end_pos;
+    size_t range_size;
+    bool unlimited_range;
+} Workload;
+
+typedef struct {
+    const char* engine;
+    unsigned queue_depth;
+    unsigned submit_batch;
+    unsigned threads;
+    bool pin;
+    bool file_per_thread;
+    bool quiet;
+    const char* timeline_path;
+    unsigned long long seed;
+    double theta;
+    unsigned read_percent;
+    unsigned hot_ops_percent;
+    unsigned hot_data_percent;
+    size_t stride;
+    const char* madvise;
+    int advice;
+    size_t batch;
+} LoaderOptions;
+
+typedef struct {
+    unsigned id;
+    int cpu;
+    Workload workload;
+    const LoaderOptions* options;
+    pthread_barrier_t* barrier;
+
+    IoMode io_mode;
+    int fd;
+    FILE* file;
+    size_t file_size;
+    char* buffer;
+    Rng rng;
+
+    size_t blocks_processed;
+    Histogram* latency;
+    Timeline timeline;
+    struct timespec start_time;
+    struct timespec end_time;
+} Worker;
+
+int next_position(const Workload* workload, size_t block_index, Rng* rng, size_t* position);
+bool next_is_write(const Workload* workload, Rng* rng);
+void record_op(Worker* worker, const struct timespec* start, const struct timespec* end, size_t blocks);
+/* Grows the file to at least end bytes with fallocate, or ftruncate where that is unsupported. */
+int preallocate(int fd, size_t end);
+/* Maps a madvise= name to its MADV_* constant; NULL is MADV_NORMAL. */
+int parse_advice(const char* name, int* advice);
+size_t run_io_uring(Worker* worker);
+size_t run_mmap(Worker* worker);
+
+#endif
@@ -8,24 +8,51 @@
 #include <unistd.h>
 #include <time.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "loader.h"
+
+#ifdef VTSH_LOADER_VTPC
+#include "vtpc.h"
+#endif
 
 #define BASE_10 10
-#define ALIGNMENT 512
+#define DEFAULT_QUEUE_DEPTH 32
+#define MAX_THREADS 1024
+#define DEFAULT_ZIPF_THETA 0.99
+#define DEFAULT_READ_PERCENT 50
+#define DEFAULT_HOT_OPS_PERCENT 90
+#define DEFAULT_HOT_DATA_PERCENT 10
+#define PERCENT 100
+#define MAX_BATCH IOV_MAX
+#define NSEC_IN_SEC 1000000000.0
+#define NSEC_IN_SEC_INT 1000000000LL
+#define NSEC_IN_USEC 1000.0
+#define BYTES_IN_MIB (1024.0 * 1024.0)
 
 int parse_range(const char *range, size_t *left, size_t *right) {
     if (range == NULL) {
         return -1;
     }
     
-    int temp_left;
-    int temp_right;
-    int parsed = sscanf(range, "%d-%d", &temp_left, &temp_right);
-    
-    if (parsed != 2) {
+    unsigned long long temp_left;
+    unsigned long long temp_right;
+    int consumed = 0;
+
+    if (range[0] < '0' || range[0] > '9' || strchr(range, '+') != NULL) {
+        return -1;
+    }
+
+    int parsed = sscanf(range, "%llu-%llu%n", &temp_left, &temp_right, &consumed);
+
+    if (parsed != 2 || range[consumed] != '\0' || strchr(range, '-') != strrchr(range, '-')) {
         return -1;
     }
 
-    if (temp_left < 0 || temp_right < 0 || temp_left > temp_right) {
+    if (temp_left > temp_right) {
         return -1;
     }
     
@@ -35,249 +62,984 @@ int parse_range(const char *range, size_t *left, size_t *right) {
     return 0;
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 8) {
-        printf("You passed %d args, expected 7\n", argc-1);
-        printf("Usage: main [rw] [blocks_size] [block_count] [file] [range] [direct] [type]\n");
-        return 0;
+int parse_rw_mode(const char *value, RwMode *mode) {
+    if (strcmp(value, "r") == 0) {
+        *mode = RW_READ;
+    } else if (strcmp(value, "w") == 0) {
+        *mode = RW_WRITE;
+    } else if (strcmp(value, "mix") == 0) {
+        *mode = RW_MIX;
+    } else {
+        return -1;
     }
+    return 0;
+}
 
-    char* rw = argv[1];
-    size_t block_size = (size_t)strtoull(argv[2], NULL, BASE_10);
-    size_t block_count = (size_t)strtoull(argv[3], NULL, BASE_10);
-    char* file_path = argv[4];
-    size_t left_range;
-    size_t right_range;
-    bool direct = strcmp(argv[6], "on") == 0;
-    char* type = argv[7];
-
-    if (parse_range(argv[5], &left_range, &right_range) != 0) {
-        printf("Invalid range format. Use: start-end (with start <= end)\n");
+int parse_pattern(const char *value, AccessPattern *pattern) {
+    if (strcmp(value, "sequential") == 0) {
+        *pattern = ACCESS_SEQUENTIAL;
+    } else if (strcmp(value, "random") == 0) {
+        *pattern = ACCESS_RANDOM;
+    } else if (strcmp(value, "zipf") == 0) {
+        *pattern = ACCESS_ZIPF;
+    } else if (strcmp(value, "hotspot") == 0) {
+        *pattern = ACCESS_HOTSPOT;
+    } else if (strcmp(value, "stride") == 0) {
+        *pattern = ACCESS_STRIDE;
+    } else {
         return -1;
     }
+    return 0;
+}
 
-    if (direct && (block_size % ALIGNMENT != 0)) {
-        printf("For O_DIRECT, block_size must be multiple of %d\n", ALIGNMENT);
+int parse_io_mode(const char *value, IoMode *mode) {
+    if (strcmp(value, "on") == 0) {
+        *mode = IO_DIRECT;
+    } else if (strcmp(value, "off") == 0) {
+        *mode = IO_STDIO;
+    } else if (strcmp(value, "vtpc") == 0) {
+#ifdef VTSH_LOADER_VTPC
+        *mode = IO_VTPC;
+#else
+        printf("Loader was built without vtpc, reconfigure with -DVTSH_LOADER_VTPC=ON\n");
+        return -1;
+#endif
+    } else {
         return -1;
     }
+    return 0;
+}
 
-    int fd = -1;
-    FILE* file = NULL;
-    bool use_direct = direct;
+const char *io_mode_name(IoMode mode) {
+    switch (mode) {
+        case IO_DIRECT:
+            return "on";
+        case IO_VTPC:
+            return "vtpc";
+        default:
+            return "off";
+    }
+}
 
-    if (use_direct) {
-        fd = open(file_path, O_RDWR | O_CREAT | O_DIRECT, 0644);
-        if (fd == -1) {
+int close_file(IoMode mode, int fd, FILE *file) {
+#ifdef VTSH_LOADER_VTPC
+    if (mode == IO_VTPC) {
+        return vtpc_close(fd);
+    }
+#endif
+    if (mode == IO_DIRECT) {
+        return close(fd);
+    }
+    return file ? fclose(file) : 0;
+}
+
+bool option_is(const char *arg, size_t key_length, const char *key) {
+    return strlen(key) == key_length && strncmp(arg, key, key_length) == 0;
+}
+
+int open_target(const char *path, Worker *worker) {
+    worker->fd = -1;
+    worker->file = NULL;
+
+    if (worker->io_mode == IO_DIRECT) {
+        worker->fd = open(path, O_RDWR | O_CREAT | O_DIRECT, 0644);
+        if (worker->fd == -1) {
             perror("Error opening file with O_DIRECT");
-            use_direct = false;
+            worker->io_mode = IO_STDIO;
         }
     }
-    
-    if (!use_direct) {
-        file = fopen(file_path, "r+b");
-        if (file == NULL) {
-            file = fopen(file_path, "w+b");
-            if (file == NULL) {
+
+#ifdef VTSH_LOADER_VTPC
+    if (worker->io_mode == IO_VTPC) {
+        worker->fd = vtpc_open(path, O_RDWR | O_CREAT, 0644);
+        if (worker->fd == -1) {
+            perror("Error opening file with vtpc");
+            return -1;
+        }
+    }
+#endif
+
+    if (worker->io_mode == IO_STDIO) {
+        worker->file = fopen(path, "r+b");
+        if (worker->file == NULL) {
+            worker->file = fopen(path, "w+b");
+            if (worker->file == NULL) {
                 perror("Error opening file for read/write");
                 return -1;
             }
         }
     }
 
-    size_t file_size = 0;
-    if (use_direct) {
-        file_size = lseek(fd, 0, SEEK_END);
-        lseek(fd, 0, SEEK_SET);
+    if (worker->io_mode == IO_DIRECT) {
+        worker->file_size = lseek(worker->fd, 0, SEEK_END);
+        lseek(worker->fd, 0, SEEK_SET);
+#ifdef VTSH_LOADER_VTPC
+    } else if (worker->io_mode == IO_VTPC) {
+        worker->file_size = vtpc_lseek(worker->fd, 0, SEEK_END);
+        vtpc_lseek(worker->fd, 0, SEEK_SET);
+#endif
     } else {
-        fseek(file, 0, SEEK_END);
-        file_size = ftell(file);
-        fseek(file, 0, SEEK_SET);
+        fseek(worker->file, 0, SEEK_END);
+        worker->file_size = ftell(worker->file);
+        fseek(worker->file, 0, SEEK_SET);
     }
 
-    size_t start_pos, end_pos;
-    bool unlimited_range = false;
-    
-    if (left_range == 0 && right_range == 0) {
-        start_pos = 0;
-        if (strcmp(rw, "w") == 0 && strcmp(type, "sequential") == 0) {
-            unlimited_range = true;
-            end_pos = 0;
-        } else {
-            end_pos = file_size;
+    return 0;
+}
+
+int parse_options(int argc, char *argv[], LoaderOptions *options) {
+    options->engine = "sync";
+    options->queue_depth = DEFAULT_QUEUE_DEPTH;
+    options->submit_batch = 0;
+    options->threads = 1;
+    options->pin = false;
+    options->file_per_thread = false;
+    options->quiet = false;
+    options->timeline_path = NULL;
+    options->seed = (unsigned long long)time(NULL);
+    options->theta = DEFAULT_ZIPF_THETA;
+    options->read_percent = DEFAULT_READ_PERCENT;
+    options->hot_ops_percent = DEFAULT_HOT_OPS_PERCENT;
+    options->hot_data_percent = DEFAULT_HOT_DATA_PERCENT;
+    options->stride = 1;
+    options->madvise = NULL;
+    parse_advice(NULL, &options->advice);
+    options->batch = 0;
+
+    for (int i = 0; i < argc; i++) {
+        char *value = strchr(argv[i], '=');
+        if (value == NULL) {
+            printf("Invalid option '%s'. Use key=value\n", argv[i]);
+            return -1;
         }
-    } else {
-        start_pos = left_range;
-        end_pos = right_range;
-        if (strcmp(rw, "r") == 0 && end_pos > file_size) {
-            end_pos = file_size;
+        size_t key_length = (size_t)(value - argv[i]);
+        value++;
+
+        if (option_is(argv[i], key_length, "engine")) {
+            if (strcmp(value, "sync") != 0 && strcmp(value, "io_uring") != 0 && strcmp(value, "mmap") != 0) {
+                printf("Invalid engine '%s'. Use 'sync', 'io_uring' or 'mmap'\n", value);
+                return -1;
+            }
+            options->engine = value;
+        } else if (option_is(argv[i], key_length, "qd")) {
+            options->queue_depth = (unsigned)strtoul(value, NULL, BASE_10);
+            if (options->queue_depth == 0) {
+                printf("Queue depth must be positive\n");
+                return -1;
+            }
+        } else if (option_is(argv[i], key_length, "submit_batch")) {
+            options->submit_batch = (unsigned)strtoul(value, NULL, BASE_10);
+        } else if (option_is(argv[i], key_length, "threads")) {
+            options->threads = (unsigned)strtoul(value, NULL, BASE_10);
+            if (options->threads == 0 || options->threads > MAX_THREADS) {
+                printf("Thread count must be in 1-%d\n", MAX_THREADS);
+                return -1;
+            }
+        } else if (option_is(argv[i], key_length, "pin")) {
+            options->pin = strcmp(value, "on") == 0;
+        } else if (option_is(argv[i], key_length, "files")) {
+            if (strcmp(value, "shared") != 0 && strcmp(value, "per-thread") != 0) {
+                printf("Invalid files value '%s'. Use 'shared' or 'per-thread'\n", value);
+                return -1;
+            }
+            options->file_per_thread = strcmp(value, "per-thread") == 0;
+        } else if (option_is(argv[i], key_length, "quiet")) {
+            options->quiet = strcmp(value, "on") == 0;
+        } else if (option_is(argv[i], key_length, "timeline")) {
+            options->timeline_path = value;
+        } else if (option_is(argv[i], key_length, "seed")) {
+            options->seed = strtoull(value, NULL, BASE_10);
+        } else if (option_is(argv[i], key_length, "theta")) {
+            options->theta = strtod(value, NULL);
+            if (!(options->theta > 0.0 && options->theta < 1.0)) {
+                printf("Zipf theta must be in (0, 1)\n");
+                return -1;
+            }
+        } else if (option_is(argv[i], key_length, "rwmix")) {
+            options->read_percent = (unsigned)strtoul(value, NULL, BASE_10);
+            if (options->read_percent > 100) {
+                printf("rwmix is the read percentage and must be in 0-100\n");
+                return -1;
+            }
+        } else if (option_is(argv[i], key_length, "hotspot")) {
+            if (sscanf(value, "%u/%u", &options->hot_ops_percent, &options->hot_data_percent) != 2 ||
+                options->hot_ops_percent > 100 || options->hot_data_percent == 0 || options->hot_data_percent > 100) {
+                printf("Invalid hotspot '%s'. Use <ops%%>/<data%%>, e.g. 90/10\n", value);
+                return -1;
+            }
+        } else if (option_is(argv[i], key_length, "batch")) {
+            options->batch = (size_t)strtoull(value, NULL, BASE_10);
+            if (options->batch == 0 || options->batch > MAX_BATCH) {
+                printf("Batch must be in 1-%d blocks\n", MAX_BATCH);
+                return -1;
+            }
+        } else if (option_is(argv[i], key_length, "madvise")) {
+            if (parse_advice(value, &options->advice) != 0) {
+                printf("Invalid madvise '%s'. Use normal, sequential, random, willneed or hugepage\n", value);
+                return -1;
+            }
+            options->madvise = value;
+        } else if (option_is(argv[i], key_length, "stride")) {
+            options->stride = (size_t)strtoull(value, NULL, BASE_10);
+            if (options->stride == 0) {
+                printf("Stride must be positive\n");
+                return -1;
+            }
+        } else {
+            printf("Unknown option '%.*s'\n", (int)key_length, argv[i]);
+            return -1;
         }
     }
 
-    if (!unlimited_range && start_pos > end_pos) {
-        printf("Invalid range: start cannot be greater than end\n");
-        if (use_direct) close(fd);
-        else fclose(file);
+    if (options->madvise && strcmp(options->engine, "mmap") != 0) {
+        printf("madvise= needs engine=mmap\n");
         return -1;
     }
+    if (options->submit_batch == 0 || options->submit_batch > options->queue_depth) {
+        options->submit_batch = options->queue_depth;
+    }
+    return 0;
+}
 
-    size_t range_size = end_pos - start_pos;
-    
-    if (!unlimited_range && range_size < block_size && block_count > 0) {
-        printf("Range size (%zu) is smaller than block size (%zu)\n", range_size, block_size);
-        if (use_direct) close(fd);
-        else fclose(file);
+int next_position(const Workload *workload, size_t block_index, Rng *rng, size_t *position) {
+    if (workload->pattern == ACCESS_SEQUENTIAL ||
+        (workload->pattern == ACCESS_STRIDE && workload->unlimited_range)) {
+        size_t step = workload->pattern == ACCESS_STRIDE ? workload->stride : 1;
+        *position = workload->start_pos + (block_index * step * workload->block_size);
+        if (!workload->unlimited_range && *position + workload->block_size > workload->end_pos) {
+            return 1;
+        }
+        return 0;
+    }
+
+    uint64_t slots = workload->range_size / workload->block_size;
+    if (slots == 0) {
+        return 1;
+    }
+
+    uint64_t slot;
+    switch (workload->pattern) {
+        case ACCESS_STRIDE:
+            slot = (uint64_t)(((unsigned __int128)block_index * workload->stride) % slots);
+            break;
+        case ACCESS_ZIPF:
+            slot = zipf_next(&workload->zipf, rng);
+            break;
+        case ACCESS_HOTSPOT: {
+            uint64_t hot_slots = slots * workload->hot_data_percent / PERCENT;
+            if (hot_slots == 0) {
+                hot_slots = 1;
+            }
+            if (rng_below(rng, PERCENT) < workload->hot_ops_percent || hot_slots == slots) {
+                slot = rng_below(rng, hot_slots);
+            } else {
+                slot = hot_slots + rng_below(rng, slots - hot_slots);
+            }
+            break;
+        }
+        default:
+            slot = rng_below(rng, slots);
+            break;
+    }
+
+    *position = workload->start_pos + (size_t)slot * workload->block_size;
+    return 0;
+}
+
+bool next_is_write(const Workload *workload, Rng *rng) {
+    if (workload->rw_mode == RW_MIX) {
+        return rng_below(rng, PERCENT) >= workload->read_percent;
+    }
+    return workload->rw_mode == RW_WRITE;
+}
+
+double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / NSEC_IN_SEC;
+}
+
+int preallocate(int fd, size_t end) {
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < 0) {
         return -1;
     }
+    if ((size_t)size >= end) {
+        return 0;
+    }
 
-    if (strcmp(type, "random") == 0) {
-        srand((unsigned int)time(NULL));
+    if (fallocate(fd, 0, size, (off_t)end - size) == 0) {
+        return 0;
+    }
+    if (errno != EOPNOTSUPP) {
+        return -1;
     }
+    return ftruncate(fd, (off_t)end);
+}
 
-    char* buffer = NULL;
-    if (use_direct) {
-        int result = posix_memalign((void**)&buffer, ALIGNMENT, block_size);
-        if (result != 0) {
-            printf("Memory allocation failed for O_DIRECT: %s\n", strerror(result));
-            if (use_direct) close(fd);
-            else if (file) fclose(file);
-            return -1;
+int sync_op(Worker *worker, size_t block_index, size_t current_pos, bool is_write) {
+    const Workload *workload = &worker->workload;
+    int fd = worker->fd;
+    FILE *file = worker->file;
+    char *buffer = worker->buffer;
+    bool use_direct = worker->io_mode == IO_DIRECT;
+#ifdef VTSH_LOADER_VTPC
+    bool use_vtpc = worker->io_mode == IO_VTPC;
+#endif
+
+    if (!is_write) {
+#ifdef VTSH_LOADER_VTPC
+        if (use_vtpc) {
+            if (vtpc_lseek(fd, (off_t)current_pos, SEEK_SET) == (off_t)-1) {
+                perror("Error seeking in file");
+                return -1;
+            }
+            ssize_t bytes_read = vtpc_read(fd, buffer, workload->block_size);
+            if (bytes_read <= 0) {
+                if (bytes_read == 0) {
+                    printf("End of file reached\n");
+                } else {
+                    perror("Error reading file");
+                }
+                return -1;
+            }
+            return 0;
+        }
+#endif
+        if (use_direct) {
+            off_t seek_result = lseek(fd, current_pos, SEEK_SET);
+            if (seek_result == (off_t)-1) {
+                perror("Error seeking in file");
+                return -1;
+            }
+            ssize_t bytes_read = read(fd, buffer, workload->block_size);
+            if (bytes_read <= 0) {
+                if (bytes_read == 0) {
+                    printf("End of file reached\n");
+                } else {
+                    perror("Error reading file");
+                }
+                return -1;
+            }
+        } else {
+            if (fseek(file, current_pos, SEEK_SET) != 0) {
+                perror("Error seeking in file");
+                return -1;
+            }
+            size_t bytes_read = fread(buffer, 1, workload->block_size, file);
+            if (bytes_read == 0) {
+                if (feof(file)) {
+                    printf("End of file reached\n");
+                } else {
+                    perror("Error reading file");
+                }
+                return -1;
+            }
         }
     } else {
-        buffer = malloc(block_size);
-        if (buffer == NULL) {
-            printf("Memory allocation failed\n");
-            if (file) fclose(file);
-            return -1;
+#ifdef VTSH_LOADER_VTPC
+        if (use_vtpc) {
+            if (vtpc_lseek(fd, (off_t)current_pos, SEEK_SET) == (off_t)-1) {
+                perror("Error seeking in file");
+                return -1;
+            }
+            memset(buffer, 'A' + (block_index % 26), workload->block_size);
+            ssize_t bytes_written = vtpc_write(fd, buffer, workload->block_size);
+            if (bytes_written != (ssize_t)workload->block_size) {
+                perror("Error writing to file");
+                return -1;
+            }
+            if (!worker->options->quiet) {
+                printf("Written %zd bytes to position %zu\n", bytes_written, current_pos);
+            }
+            return 0;
+        }
+#endif
+        if (use_direct) {
+            if (current_pos + workload->block_size > worker->file_size) {
+                if (preallocate(fd, current_pos + workload->block_size) != 0) {
+                    perror("Error expanding file size");
+                    return -1;
+                }
+                worker->file_size = current_pos + workload->block_size;
+            }
+            off_t seek_result = lseek(fd, current_pos, SEEK_SET);
+            if (seek_result == (off_t)-1) {
+                perror("Error seeking in file");
+                return -1;
+            }
+            memset(buffer, 'A' + (block_index % 26), workload->block_size);
+            ssize_t bytes_written = write(fd, buffer, workload->block_size);
+            if (bytes_written != (ssize_t)workload->block_size) {
+                perror("Error writing to file");
+                return -1;
+            }
+            if (!worker->options->quiet) {
+                printf("Written %zd bytes to position %zu\n", bytes_written, current_pos);
+            }
+        } else {
+            if (current_pos + workload->block_size > worker->file_size) {
+                /* Pending stdio writes must reach the file before its size is checked. */
+                if (fflush(file) != 0 || preallocate(fileno(file), current_pos + workload->block_size) != 0) {
+                    perror("Error expanding file size");
+                    return -1;
+                }
+                worker->file_size = current_pos + workload->block_size;
+            }
+            if (fseek(file, current_pos, SEEK_SET) != 0) {
+                perror("Error seeking in file");
+                return -1;
+            }
+            memset(buffer, 'A' + (block_index % 26), workload->block_size);
+            size_t bytes_written = fwrite(buffer, 1, workload->block_size, file);
+            if (bytes_written != workload->block_size) {
+                perror("Error writing to file");
+                return -1;
+            }
+            if (!worker->options->quiet) {
+                printf("Written %zu bytes to position %zu\n", bytes_written, current_pos);
+            }
         }
     }
+    return 0;
+}
+
+uint64_t elapsed_nanoseconds(const struct timespec *start, const struct timespec *end) {
+    int64_t nanoseconds = (int64_t)(end->tv_sec - start->tv_sec) * NSEC_IN_SEC_INT + (end->tv_nsec - start->tv_nsec);
+    return nanoseconds > 0 ? (uint64_t)nanoseconds : 0;
+}
 
-    printf("Processing: mode=%s, block_size=%zu, block_count=%zu, range=%zu-%zu, type=%s, direct=%s\n",
-           rw, block_size, block_count, start_pos, end_pos, type, use_direct ? "on" : "off");
+/* Records one request; a batched request moves several blocks but contributes a single latency sample. */
+void record_op(Worker *worker, const struct timespec *start, const struct timespec *end, size_t blocks) {
+    uint64_t latency = elapsed_nanoseconds(start, end);
+    histogram_record(worker->latency, latency);
 
+    if (worker->options->timeline_path != NULL) {
+        size_t second = (size_t)(elapsed_nanoseconds(&worker->start_time, end) / NSEC_IN_SEC_INT);
+        timeline_record(&worker->timeline, second, latency, blocks);
+    }
+}
+
+size_t run_sync(Worker *worker) {
+    const Workload *workload = &worker->workload;
     size_t blocks_processed = 0;
     size_t block_index;
-    for (block_index = 0; block_index < block_count; block_index++) {
+
+    for (block_index = 0; block_index < workload->block_count; block_index++) {
         size_t current_pos;
-        
-        if (strcmp(type, "sequential") == 0) {
-            current_pos = start_pos + (block_index * block_size);
-            if (!unlimited_range && current_pos + block_size > end_pos) {
-                break;
-            }
-        } else if (strcmp(type, "random") == 0) {
-            if (range_size < block_size) {
-                break;
-            }
-            size_t max_pos = end_pos - block_size;
-            if (start_pos > max_pos) {
-                break;
+
+        if (next_position(workload, block_index, &worker->rng, &current_pos) != 0) {
+            break;
+        }
+
+        bool is_write = next_is_write(workload, &worker->rng);
+
+        struct timespec op_start, op_end;
+        clock_gettime(CLOCK_MONOTONIC, &op_start);
+        if (sync_op(worker, block_index, current_pos, is_write) != 0) {
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &op_end);
+        record_op(worker, &op_start, &op_end, 1);
+        blocks_processed++;
+    }
+
+    return blocks_processed;
+}
+
+/*
+ * Sequential mode with batch=K: K contiguous blocks per preadv/pwritev at an
+ * explicit offset, so there is one syscall per batch and no lseek at all.
+ */
+size_t run_batched(Worker *worker) {
+    const Workload *workload = &worker->workload;
+    size_t batch = worker->options->batch;
+    int fd = worker->io_mode == IO_DIRECT ? worker->fd : fileno(worker->file);
+    struct iovec iovecs[MAX_BATCH];
+    size_t blocks_processed = 0;
+
+    for (size_t i = 0; i < batch; i++) {
+        iovecs[i].iov_base = worker->buffer + i * workload->block_size;
+        iovecs[i].iov_len = workload->block_size;
+    }
+
+    size_t block_index = 0;
+    while (block_index < workload->block_count) {
+        size_t first_pos;
+        if (next_position(workload, block_index, &worker->rng, &first_pos) != 0) {
+            break;
+        }
+
+        size_t count = 0;
+        size_t position;
+        while (count < batch && block_index + count < workload->block_count &&
+               next_position(workload, block_index + count, &worker->rng, &position) == 0) {
+            count++;
+        }
+
+        bool is_write = next_is_write(workload, &worker->rng);
+        size_t expected = count * workload->block_size;
+
+        struct timespec op_start, op_end;
+        clock_gettime(CLOCK_MONOTONIC, &op_start);
+        ssize_t result;
+        if (is_write) {
+            for (size_t i = 0; i < count; i++) {
+                memset(iovecs[i].iov_base, 'A' + ((block_index + i) % 26), workload->block_size);
             }
-            current_pos = start_pos + (rand() % (max_pos - start_pos + 1));
-            current_pos = start_pos + ((current_pos - start_pos) / block_size) * block_size;
+            result = pwritev(fd, iovecs, (int)count, (off_t)first_pos);
         } else {
-            printf("Invalid type. Use 'sequential' or 'random'\n");
+            result = preadv(fd, iovecs, (int)count, (off_t)first_pos);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &op_end);
+
+        if (result < 0) {
+            perror(is_write ? "Error writing to file" : "Error reading file");
             break;
         }
 
-        if (strcmp(rw, "r") == 0) {
-            if (use_direct) {
-                off_t seek_result = lseek(fd, current_pos, SEEK_SET);
-                if (seek_result == (off_t)-1) {
-                    perror("Error seeking in file");
-                    break;
-                }
-                ssize_t bytes_read = read(fd, buffer, block_size);
-                if (bytes_read > 0) {
-                    blocks_processed++;
-                } else {
-                    if (bytes_read == 0) {
-                        printf("End of file reached\n");
-                    } else {
-                        perror("Error reading file");
-                    }
-                    break;
-                }
+        size_t done = (size_t)result / workload->block_size;
+        if (done > 0) {
+            record_op(worker, &op_start, &op_end, done);
+        }
+        blocks_processed += done;
+
+        if (is_write && !worker->options->quiet) {
+            printf("Written %zd bytes to position %zu\n", result, first_pos);
+        }
+        if ((size_t)result < expected) {
+            if (!is_write) {
+                printf("End of file reached\n");
             } else {
-                if (fseek(file, current_pos, SEEK_SET) != 0) {
-                    perror("Error seeking in file");
-                    break;
-                }
-                size_t bytes_read = fread(buffer, 1, block_size, file);
-                if (bytes_read > 0) {
-                    blocks_processed++;
-                } else {
-                    if (feof(file)) {
-                        printf("End of file reached\n");
-                    } else {
-                        perror("Error reading file");
-                    }
-                    break;
-                }
+                printf("Short write of %zd bytes at position %zu\n", result, first_pos);
             }
+            break;
+        }
+        block_index += count;
+    }
+
+    return blocks_processed;
+}
+
+int compute_range(const Workload *request, size_t left_range, size_t right_range, size_t file_size, Workload *workload) {
+    *workload = *request;
+    workload->unlimited_range = false;
+
+    if (left_range == 0 && right_range == 0) {
+        workload->start_pos = 0;
+        if (request->rw_mode == RW_WRITE &&
+            (request->pattern == ACCESS_SEQUENTIAL || request->pattern == ACCESS_STRIDE)) {
+            workload->unlimited_range = true;
+            workload->end_pos = 0;
         } else {
-            if (use_direct) {
-                if (current_pos + block_size > file_size) {
-                    if (ftruncate(fd, current_pos + block_size) == -1) {
-                        perror("Error expanding file size");
-                        break;
-                    }
-                    file_size = current_pos + block_size;
-                }
-                off_t seek_result = lseek(fd, current_pos, SEEK_SET);
-                if (seek_result == (off_t)-1) {
-                    perror("Error seeking in file");
-                    break;
-                }
-                memset(buffer, 'A' + (block_index % 26), block_size);
-                ssize_t bytes_written = write(fd, buffer, block_size);
-                if (bytes_written == (ssize_t)block_size) {
-                    printf("Written %zd bytes to position %zu\n", bytes_written, current_pos);
-                    blocks_processed++;
-                } else {
-                    perror("Error writing to file");
-                    break;
-                }
-            } else {
-                if (current_pos + block_size > file_size) {
-                    fseek(file, current_pos + block_size - 1, SEEK_SET);
-                    fputc(0, file);
-                    fflush(file);
-                    file_size = current_pos + block_size;
-                }
-                if (fseek(file, current_pos, SEEK_SET) != 0) {
-                    perror("Error seeking in file");
-                    break;
-                }
-                memset(buffer, 'A' + (block_index % 26), block_size);
-                size_t bytes_written = fwrite(buffer, 1, block_size, file);
-                if (bytes_written == block_size) {
-                    printf("Written %zu bytes to position %zu\n", bytes_written, current_pos);
-                    blocks_processed++;
-                } else {
-                    perror("Error writing to file");
-                    break;
-                }
+            workload->end_pos = file_size;
+        }
+    } else {
+        workload->start_pos = left_range;
+        workload->end_pos = right_range;
+        if (request->rw_mode != RW_WRITE && workload->end_pos > file_size) {
+            workload->end_pos = file_size;
+        }
+    }
+
+    if (!workload->unlimited_range && workload->start_pos > workload->end_pos) {
+        printf("Invalid range: start cannot be greater than end\n");
+        return -1;
+    }
+
+    workload->range_size = workload->end_pos - workload->start_pos;
+
+    if (!workload->unlimited_range && workload->range_size < workload->block_size && workload->block_count > 0) {
+        printf("Range size (%zu) is smaller than block size (%zu)\n", workload->range_size, workload->block_size);
+        return -1;
+    }
+    return 0;
+}
+
+void split_evenly(size_t total, unsigned parts, unsigned index, size_t *first, size_t *count) {
+    size_t base = total / parts;
+    size_t extra = total % parts;
+    *count = base + (index < extra ? 1 : 0);
+    *first = index * base + (index < extra ? index : extra);
+}
+
+/* Gives every worker its own share of the blocks and a disjoint, block-aligned part of the range. */
+void partition_workload(const Workload *whole, unsigned parts, unsigned index, Workload *part) {
+    size_t first;
+    size_t count;
+
+    *part = *whole;
+    split_evenly(whole->block_count, parts, index, &first, &count);
+    part->block_count = count;
+
+    if (whole->unlimited_range) {
+        part->start_pos = whole->start_pos + first * whole->block_size;
+        part->end_pos = part->start_pos + count * whole->block_size;
+        part->unlimited_range = false;
+    } else {
+        size_t slot_first;
+        size_t slot_count;
+        split_evenly(whole->range_size / whole->block_size, parts, index, &slot_first, &slot_count);
+        part->start_pos = whole->start_pos + slot_first * whole->block_size;
+        part->end_pos = part->start_pos + slot_count * whole->block_size;
+        if (slot_count == 0) {
+            part->block_count = 0;
+        }
+    }
+    part->range_size = part->end_pos - part->start_pos;
+}
+
+void *worker_main(void *arg) {
+    Worker *worker = arg;
+
+    if (worker->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker->cpu, &set);
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (result != 0) {
+            printf("Thread %u: failed to pin to CPU %d: %s\n", worker->id, worker->cpu, strerror(result));
+        }
+    }
+
+    pthread_barrier_wait(worker->barrier);
+    clock_gettime(CLOCK_MONOTONIC, &worker->start_time);
+
+    if (strcmp(worker->options->engine, "io_uring") == 0) {
+        worker->blocks_processed = run_io_uring(worker);
+    } else if (strcmp(worker->options->engine, "mmap") == 0) {
+        worker->blocks_processed = run_mmap(worker);
+    } else if (worker->options->batch > 0) {
+        worker->blocks_processed = run_batched(worker);
+    } else {
+        worker->blocks_processed = run_sync(worker);
+    }
+
+#ifdef VTSH_LOADER_VTPC
+    if (worker->io_mode == IO_VTPC && worker->workload.rw_mode != RW_READ && vtpc_fsync(worker->fd) != 0) {
+        perror("Error syncing file");
+    }
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC, &worker->end_time);
+    return NULL;
+}
+
+void print_throughput(const char *label, size_t blocks, size_t block_size, double elapsed) {
+    double total_mib = (double)(blocks * block_size) / BYTES_IN_MIB;
+    printf("%s: %zu blocks, elapsed: %.3f s, throughput: %.2f MiB/s, %.0f IOPS\n",
+           label,
+           blocks,
+           elapsed,
+           elapsed > 0 ? total_mib / elapsed : 0.0,
+           elapsed > 0 ? (double)blocks / elapsed : 0.0);
+}
+
+void print_latency(const Histogram *latency) {
+    if (latency->total == 0) {
+        return;
+    }
+    printf("Latency (us): min=%.1f avg=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+           (double)latency->min / NSEC_IN_USEC,
+           latency->sum / (double)latency->total / NSEC_IN_USEC,
+           (double)histogram_percentile(latency, 50.0) / NSEC_IN_USEC,
+           (double)histogram_percentile(latency, 90.0) / NSEC_IN_USEC,
+           (double)histogram_percentile(latency, 99.0) / NSEC_IN_USEC,
+           (double)histogram_percentile(latency, 99.9) / NSEC_IN_USEC,
+           (double)latency->max / NSEC_IN_USEC);
+}
+
+int release_workers(Worker *workers, unsigned count) {
+    int status = 0;
+    for (unsigned i = 0; i < count; i++) {
+        free(workers[i].buffer);
+        free(workers[i].latency);
+        timeline_free(&workers[i].timeline);
+        if (workers[i].fd != -1 || workers[i].file != NULL) {
+            if (close_file(workers[i].io_mode, workers[i].fd, workers[i].file) != 0) {
+                perror("Error closing file");
+                status = -1;
             }
         }
     }
+    free(workers);
+    return status;
+}
 
-    printf("Successfully processed %zu blocks\n", blocks_processed);
+int main(int argc, char *argv[]) {
+    if (argc < 8) {
+        printf("You passed %d args, expected 7\n", argc-1);
+        printf("Usage: main [rw: r|w|mix] [blocks_size] [block_count] [file] [range] [direct: on|off|vtpc] "
+               "[type: sequential|random|zipf|hotspot|stride] [key=value...]\n");
+        printf("Options: engine=sync|io_uring|mmap, qd=<queue depth>, submit_batch=<sqes per submit>,\n");
+        printf("         madvise=normal|sequential|random|willneed|hugepage, batch=<blocks per preadv/pwritev>,\n");
+        printf("         threads=<count>, pin=on|off, files=shared|per-thread,\n");
+        printf("         quiet=on|off, timeline=<csv path>, seed=<number>, rwmix=<read %%>,\n");
+        printf("         theta=<zipf theta>, hotspot=<ops %%>/<data %%>, stride=<blocks>\n");
+        return 0;
+    }
 
-    free(buffer);
-    
-    if (use_direct) {
-        if (close(fd) == 0) {
-            printf("File closed successfully\n");
+    char* rw = argv[1];
+    size_t block_size = (size_t)strtoull(argv[2], NULL, BASE_10);
+    size_t block_count = (size_t)strtoull(argv[3], NULL, BASE_10);
+    char* file_path = argv[4];
+    size_t left_range;
+    size_t right_range;
+    IoMode io_mode;
+    RwMode rw_mode;
+    AccessPattern pattern;
+    char* type = argv[7];
+
+    LoaderOptions options;
+
+    if (parse_rw_mode(rw, &rw_mode) != 0) {
+        printf("Invalid rw value. Use 'r', 'w' or 'mix'\n");
+        return -1;
+    }
+
+    if (parse_pattern(type, &pattern) != 0) {
+        printf("Invalid type. Use 'sequential', 'random', 'zipf', 'hotspot' or 'stride'\n");
+        return -1;
+    }
+
+    if (parse_io_mode(argv[6], &io_mode) != 0) {
+        printf("Invalid direct value. Use 'on', 'off' or 'vtpc'\n");
+        return -1;
+    }
+
+    if (parse_options(argc - 8, argv + 8, &options) != 0) {
+        return -1;
+    }
+
+    bool use_uring = strcmp(options.engine, "io_uring") == 0;
+    if (strcmp(options.engine, "sync") != 0 && io_mode == IO_VTPC) {
+        printf("engine=%s works on the file descriptor directly, it cannot be combined with direct=vtpc\n", options.engine);
+        return -1;
+    }
+
+    if (options.batch > 0 && (strcmp(options.engine, "sync") != 0 || io_mode == IO_VTPC || pattern != ACCESS_SEQUENTIAL)) {
+        printf("batch=K needs engine=sync, type=sequential and direct=on or off\n");
+        return -1;
+    }
+
+    if (options.threads > 1 && io_mode == IO_VTPC) {
+        printf("vtpc is not thread-safe, direct=vtpc requires threads=1\n");
+        return -1;
+    }
+
+    if (parse_range(argv[5], &left_range, &right_range) != 0) {
+        printf("Invalid range format. Use: start-end (with start <= end)\n");
+        return -1;
+    }
+
+    if (io_mode == IO_DIRECT && (block_size % ALIGNMENT != 0)) {
+        printf("For O_DIRECT, block_size must be multiple of %d\n", ALIGNMENT);
+        return -1;
+    }
+
+    if (block_size == 0) {
+        printf("Block size must be positive\n");
+        return -1;
+    }
+
+    unsigned thread_count = options.threads;
+    Worker *workers = calloc(thread_count, sizeof(Worker));
+    if (workers == NULL) {
+        printf("Memory allocation failed\n");
+        return -1;
+    }
+
+    Workload request = {
+        .rw = rw,
+        .type = type,
+        .rw_mode = rw_mode,
+        .pattern = pattern,
+        .read_percent = options.read_percent,
+        .hot_ops_percent = options.hot_ops_percent,
+        .hot_data_percent = options.hot_data_percent,
+        .stride = options.stride,
+        .block_size = block_size,
+        .block_count = block_count,
+    };
+    Workload whole;
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (unsigned i = 0; i < thread_count; i++) {
+        Worker *worker = &workers[i];
+        worker->id = i;
+        worker->cpu = options.pin && cpu_count > 0 ? (int)(i % (unsigned)cpu_count) : -1;
+        worker->options = &options;
+        worker->io_mode = io_mode;
+        worker->fd = -1;
+        rng_seed(&worker->rng, options.seed + i);
+
+        char path[PATH_MAX];
+        if (options.file_per_thread) {
+            snprintf(path, sizeof(path), "%s.%u", file_path, i);
         } else {
-            perror("Error closing file");
+            snprintf(path, sizeof(path), "%s", file_path);
         }
-    } else {
-        if (file && fclose(file) == 0) {
-            printf("File closed successfully\n");
+
+        if (open_target(path, worker) != 0) {
+            release_workers(workers, thread_count);
+            return -1;
+        }
+
+        if (options.file_per_thread) {
+            Workload own;
+            if (compute_range(&request, left_range, right_range, worker->file_size, &own) != 0) {
+                release_workers(workers, thread_count);
+                return -1;
+            }
+            size_t first;
+            split_evenly(block_count, thread_count, i, &first, &own.block_count);
+            worker->workload = own;
+            if (i == 0) {
+                whole = own;
+            }
         } else {
-            perror("Error closing file");
+            if (i == 0 && compute_range(&request, left_range, right_range, worker->file_size, &whole) != 0) {
+                release_workers(workers, thread_count);
+                return -1;
+            }
+            partition_workload(&whole, thread_count, i, &worker->workload);
         }
+
+        if (pattern == ACCESS_ZIPF) {
+            zipf_init(&worker->workload.zipf, worker->workload.range_size / block_size, options.theta);
+        }
+
+        size_t buffer_blocks = options.batch > 0 ? options.batch : 1;
+        int result = posix_memalign((void**)&worker->buffer, ALIGNMENT, block_size * buffer_blocks);
+        if (result != 0) {
+            worker->buffer = NULL;
+            printf("Aligned memory allocation failed: %s\n", strerror(result));
+            release_workers(workers, thread_count);
+            return -1;
+        }
+
+        worker->latency = malloc(sizeof(Histogram));
+        if (worker->latency == NULL) {
+            printf("Memory allocation failed\n");
+            release_workers(workers, thread_count);
+            return -1;
+        }
+        histogram_init(worker->latency);
+        timeline_init(&worker->timeline);
+    }
+
+    printf("Processing: mode=%s, block_size=%zu, block_count=%zu, range=%zu-%zu, type=%s, direct=%s, engine=%s\n",
+           rw, block_size, block_count, whole.start_pos, whole.end_pos, type, io_mode_name(workers[0].io_mode), options.engine);
+    if (use_uring) {
+        printf("io_uring: qd=%u, submit_batch=%u\n", options.queue_depth, options.submit_batch);
+    } else if (strcmp(options.engine, "mmap") == 0) {
+        printf("mmap: madvise=%s\n", options.madvise ? options.madvise : "normal");
+    } else if (options.batch > 0) {
+        printf("vectored: batch=%zu blocks per call\n", options.batch);
+    }
+    printf("seed=%llu", options.seed);
+    if (rw_mode == RW_MIX) {
+        printf(", rwmix=%u%% reads", options.read_percent);
+    }
+    if (pattern == ACCESS_ZIPF) {
+        printf(", theta=%.3f", options.theta);
+    } else if (pattern == ACCESS_HOTSPOT) {
+        printf(", hotspot=%u%% of ops on %u%% of data", options.hot_ops_percent, options.hot_data_percent);
+    } else if (pattern == ACCESS_STRIDE) {
+        printf(", stride=%zu blocks", options.stride);
+    }
+    printf("\n");
+    if (thread_count > 1) {
+        printf("threads=%u, files=%s, pin=%s\n",
+               thread_count, options.file_per_thread ? "per-thread" : "shared", options.pin ? "on" : "off");
+    }
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, thread_count);
+
+    pthread_t *threads = calloc(thread_count, sizeof(pthread_t));
+    unsigned started = 0;
+    if (threads != NULL) {
+        for (; started < thread_count; started++) {
+            workers[started].barrier = &barrier;
+            if (pthread_create(&threads[started], NULL, worker_main, &workers[started]) != 0) {
+                perror("Error creating thread");
+                break;
+            }
+        }
+    }
+
+    if (started != thread_count) {
+        /* Workers already waiting on the barrier can never be released, so give up right away. */
+        printf("Failed to start %u worker threads\n", thread_count);
+        _exit(EXIT_FAILURE);
+    }
+
+    for (unsigned i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_barrier_destroy(&barrier);
+
+    size_t blocks_processed = 0;
+    Histogram latency;
+    Timeline timeline;
+    histogram_init(&latency);
+    timeline_init(&timeline);
+    struct timespec first_start = workers[0].start_time;
+    struct timespec last_end = workers[0].end_time;
+    for (unsigned i = 0; i < thread_count; i++) {
+        Worker *worker = &workers[i];
+        blocks_processed += worker->blocks_processed;
+        histogram_merge(&latency, worker->latency);
+        if (options.timeline_path != NULL && timeline_merge(&timeline, &worker->timeline) != 0) {
+            printf("Memory allocation failed for the timeline\n");
+        }
+        if (elapsed_seconds(&worker->start_time, &first_start) > 0) {
+            first_start = worker->start_time;
+        }
+        if (elapsed_seconds(&last_end, &worker->end_time) > 0) {
+            last_end = worker->end_time;
+        }
+
+        if (thread_count > 1) {
+            char label[64];
+            if (worker->cpu >= 0) {
+                snprintf(label, sizeof(label), "Thread %u (cpu %d)", worker->id, worker->cpu);
+            } else {
+                snprintf(label, sizeof(label), "Thread %u", worker->id);
+            }
+            print_throughput(label, worker->blocks_processed, block_size,
+                             elapsed_seconds(&worker->start_time, &worker->end_time));
+            print_latency(worker->latency);
+        }
+    }
+
+    printf("Successfully processed %zu blocks\n", blocks_processed);
+    print_throughput("Total", blocks_processed, block_size, elapsed_seconds(&first_start, &last_end));
+    print_latency(&latency);
+
+    if (options.timeline_path != NULL) {
+        if (timeline_write_csv(&timeline, options.timeline_path, block_size) == 0) {
+            printf("Timeline written to %s\n", options.timeline_path);
+        } else {
+            perror("Error writing timeline");
+        }
+        timeline_free(&timeline);
+    }
+
+#ifdef VTSH_LOADER_VTPC
+    if (io_mode == IO_VTPC) {
+        struct vtpc_stats stats;
+        vtpc_get_stats(&stats);
+        unsigned long long lookups = stats.hits + stats.misses;
+        printf("vtpc: reads=%llu writes=%llu hits=%llu misses=%llu evictions=%llu hit_ratio=%.2f%%\n",
+               stats.reads, stats.writes, stats.hits, stats.misses, stats.evictions,
+               lookups > 0 ? 100.0 * (double)stats.hits / (double)lookups : 0.0);
+    }
+#endif
+
+    if (release_workers(workers, thread_count) == 0) {
+        printf("File closed successfully\n");
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,114 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "loader.h"
+
+int parse_advice(const char* name, int* advice) {
+    if (name == NULL || strcmp(name, "normal") == 0) {
+        *advice = MADV_NORMAL;
+    } else if (strcmp(name, "sequential") == 0) {
+        *advice = MADV_SEQUENTIAL;
+    } else if (strcmp(name, "random") == 0) {
+        *advice = MADV_RANDOM;
+    } else if (strcmp(name, "willneed") == 0) {
+        *advice = MADV_WILLNEED;
+    } else if (strcmp(name, "hugepage") == 0) {
+        *advice = MADV_HUGEPAGE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+size_t run_mmap(Worker* worker) {
+    Workload* workload = &worker->workload;
+    const LoaderOptions* options = worker->options;
+    int fd = worker->io_mode == IO_DIRECT ? worker->fd : fileno(worker->file);
+    size_t blocks_processed = 0;
+    int advice = options->advice;
+
+    size_t end = workload->end_pos;
+    if (workload->unlimited_range) {
+        end = workload->start_pos + workload->block_count * workload->block_size;
+    }
+    if (end <= workload->start_pos || workload->block_count == 0) {
+        return 0;
+    }
+
+    /* Grow the file up front so that stores into the mapping never hit SIGBUS. */
+    if (workload->rw_mode != RW_READ && preallocate(fd, end) != 0) {
+        perror("Error preallocating file");
+        return 0;
+    }
+
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t map_start = workload->start_pos - workload->start_pos % page_size;
+    size_t map_length = end - map_start;
+    int protection = workload->rw_mode == RW_READ ? PROT_READ : PROT_READ | PROT_WRITE;
+
+    char* map = mmap(NULL, map_length, protection, MAP_SHARED, fd, (off_t)map_start);
+    if (map == MAP_FAILED) {
+        perror("Error mapping file");
+        return 0;
+    }
+
+    if (advice != MADV_NORMAL && madvise(map, map_length, advice) != 0) {
+        perror("madvise failed, continuing without advice");
+    }
+
+    struct rusage usage_before;
+    getrusage(RUSAGE_THREAD, &usage_before);
+
+    bool written = false;
+    for (size_t block_index = 0; block_index < workload->block_count; block_index++) {
+        size_t position;
+        if (next_position(workload, block_index, &worker->rng, &position) != 0) {
+            break;
+        }
+        if (position + workload->block_size > end) {
+            printf("End of mapping reached\n");
+            break;
+        }
+
+        bool is_write = next_is_write(workload, &worker->rng);
+        char* block = map + (position - map_start);
+
+        struct timespec op_start, op_end;
+        clock_gettime(CLOCK_MONOTONIC, &op_start);
+        if (is_write) {
+            memset(worker->buffer, 'A' + (block_index % 26), workload->block_size);
+            memcpy(block, worker->buffer, workload->block_size);
+            written = true;
+        } else {
+            memcpy(worker->buffer, block, workload->block_size);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &op_end);
+        record_op(worker, &op_start, &op_end, 1);
+        blocks_processed++;
+
+        if (is_write && !options->quiet) {
+            printf("Written %zu bytes to position %zu\n", workload->block_size, position);
+        }
+    }
+
+    if (written && msync(map, map_length, MS_SYNC) != 0) {
+        perror("Error syncing mapping");
+    }
+
+    struct rusage usage_after;
+    getrusage(RUSAGE_THREAD, &usage_after);
+    printf("Thread %u mmap: minor faults=%ld, major faults=%ld\n",
+           worker->id,
+           usage_after.ru_minflt - usage_before.ru_minflt,
+           usage_after.ru_majflt - usage_before.ru_majflt);
+
+    munmap(map, map_length);
+    return blocks_processed;
+}
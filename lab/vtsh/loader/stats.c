@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+#define NSEC_IN_USEC 1000.0
+#define BYTES_IN_MIB (1024.0 * 1024.0)
+#define TIMELINE_INITIAL_CAPACITY 64
+
+static size_t histogram_index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_COUNT) {
+        return (size_t)value;
+    }
+    unsigned exponent = 63U - (unsigned)__builtin_clzll(value);
+    unsigned shift = exponent - HISTOGRAM_SUB_BITS;
+    size_t sub = (size_t)((value >> shift) & (HISTOGRAM_SUB_COUNT - 1));
+    return ((size_t)(shift + 1) << HISTOGRAM_SUB_BITS) + sub;
+}
+
+/* Largest value that still falls into the bucket, so percentiles never under-report. */
+static uint64_t histogram_bucket_limit(size_t index) {
+    if (index < HISTOGRAM_SUB_COUNT) {
+        return (uint64_t)index;
+    }
+    unsigned shift = (unsigned)(index >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t sub = index & (HISTOGRAM_SUB_COUNT - 1);
+    uint64_t lower = (HISTOGRAM_SUB_COUNT + sub) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void histogram_init(Histogram* histogram) {
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->min = UINT64_MAX;
+}
+
+void histogram_record(Histogram* histogram, uint64_t value) {
+    histogram->counts[histogram_index(value)]++;
+    histogram->total++;
+    histogram->sum += (double)value;
+    if (value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+void histogram_merge(Histogram* target, const Histogram* source) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        target->counts[i] += source->counts[i];
+    }
+    target->total += source->total;
+    target->sum += source->sum;
+    if (source->min < target->min) {
+        target->min = source->min;
+    }
+    if (source->max > target->max) {
+        target->max = source->max;
+    }
+}
+
+uint64_t histogram_percentile(const Histogram* histogram, double percentile) {
+    if (histogram->total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)((percentile / 100.0) * (double)histogram->total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t limit = histogram_bucket_limit(i);
+            return limit < histogram->max ? limit : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void timeline_init(Timeline* timeline) {
+    memset(timeline, 0, sizeof(*timeline));
+}
+
+static int timeline_reserve(Timeline* timeline, size_t seconds) {
+    if (seconds <= timeline->capacity) {
+        return 0;
+    }
+
+    size_t capacity = timeline->capacity ? timeline->capacity : TIMELINE_INITIAL_CAPACITY;
+    while (capacity < seconds) {
+        capacity *= 2;
+    }
+
+    uint64_t* blocks = realloc(timeline->blocks, capacity * sizeof(uint64_t));
+    if (blocks == NULL) {
+        return -1;
+    }
+    timeline->blocks = blocks;
+
+    uint64_t* requests = realloc(timeline->requests, capacity * sizeof(uint64_t));
+    if (requests == NULL) {
+        return -1;
+    }
+    timeline->requests = requests;
+
+    uint64_t* latency_sum = realloc(timeline->latency_sum, capacity * sizeof(uint64_t));
+    if (latency_sum == NULL) {
+        return -1;
+    }
+    timeline->latency_sum = latency_sum;
+
+    memset(timeline->blocks + timeline->capacity, 0, (capacity - timeline->capacity) * sizeof(uint64_t));
+    memset(timeline->requests + timeline->capacity, 0, (capacity - timeline->capacity) * sizeof(uint64_t));
+    memset(timeline->latency_sum + timeline->capacity, 0, (capacity - timeline->capacity) * sizeof(uint64_t));
+    timeline->capacity = capacity;
+    return 0;
+}
+
+int timeline_record(Timeline* timeline, size_t second, uint64_t latency, uint64_t blocks) {
+    if (timeline_reserve(timeline, second + 1) != 0) {
+        return -1;
+    }
+    timeline->blocks[second] += blocks;
+    timeline->requests[second]++;
+    timeline->latency_sum[second] += latency;
+    if (second + 1 > timeline->seconds) {
+        timeline->seconds = second + 1;
+    }
+    return 0;
+}
+
+int timeline_merge(Timeline* target, const Timeline* source) {
+    if (timeline_reserve(target, source->seconds) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < source->seconds; i++) {
+        target->blocks[i] += source->blocks[i];
+        target->requests[i] += source->requests[i];
+        target->latency_sum[i] += source->latency_sum[i];
+    }
+    if (source->seconds > target->seconds) {
+        target->seconds = source->seconds;
+    }
+    return 0;
+}
+
+int timeline_write_csv(const Timeline* timeline, const char* path, size_t block_size) {
+    FILE* output = fopen(path, "w");
+    if (output == NULL) {
+        return -1;
+    }
+
+    fprintf(output, "second,iops,mib_per_s,requests,avg_latency_us\n");
+    for (size_t i = 0; i < timeline->seconds; i++) {
+        uint64_t blocks = timeline->blocks[i];
+        uint64_t requests = timeline->requests[i];
+        fprintf(output, "%zu,%llu,%.2f,%llu,%.2f\n",
+                i,
+                (unsigned long long)blocks,
+                (double)blocks * (double)block_size / BYTES_IN_MIB,
+                (unsigned long long)requests,
+                requests > 0 ? (double)timeline->latency_sum[i] / (double)requests / NSEC_IN_USEC : 0.0);
+    }
+
+    return fclose(output);
+}
+
+void timeline_free(Timeline* timeline) {
+    free(timeline->blocks);
+    free(timeline->requests);
+    free(timeline->latency_sum);
+    timeline_init(timeline);
+}
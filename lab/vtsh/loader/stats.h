@@ -0,0 +1,43 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Log-linear latency histogram: every power of two is split into
+ * 2^HISTOGRAM_SUB_BITS equal buckets, which keeps the relative error
+ * of a reported percentile under 1 / 2^HISTOGRAM_SUB_BITS.
+ */
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_COUNT (1U << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} Histogram;
+
+typedef struct {
+    uint64_t* blocks;
+    uint64_t* requests;
+    uint64_t* latency_sum;
+    size_t capacity;
+    size_t seconds;
+} Timeline;
+
+void histogram_init(Histogram* histogram);
+void histogram_record(Histogram* histogram, uint64_t value);
+void histogram_merge(Histogram* target, const Histogram* source);
+uint64_t histogram_percentile(const Histogram* histogram, double percentile);
+
+void timeline_init(Timeline* timeline);
+int timeline_record(Timeline* timeline, size_t second, uint64_t latency, uint64_t blocks);
+int timeline_merge(Timeline* target, const Timeline* source);
+int timeline_write_csv(const Timeline* timeline, const char* path, size_t block_size);
+void timeline_free(Timeline* timeline);
+
+#endif
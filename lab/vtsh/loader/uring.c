@@ -0,0 +1,358 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "loader.h"
+#include "uring.h"
+
+/*
+ * Minimal io_uring wrapper on top of the raw syscalls: the lab forbids
+ * high-level abstractions over system calls, so liburing is not used.
+ */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int ring_fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+int uring_init(Uring* ring, unsigned entries) {
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+
+    ring->ring_fd = sys_io_uring_setup(entries, &params);
+    if (ring->ring_fd < 0) {
+        return -1;
+    }
+    ring->entries = params.sq_entries;
+
+    ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len) {
+            ring->sq_len = ring->cq_len;
+        }
+        ring->cq_len = ring->sq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        uring_destroy(ring);
+        return -1;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            uring_destroy(ring);
+            return -1;
+        }
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_destroy(ring);
+        return -1;
+    }
+
+    char* sq = ring->sq_ptr;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+
+    char* cq = ring->cq_ptr;
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+void uring_destroy(Uring* ring) {
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_len);
+    }
+    if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_len);
+    }
+    if (ring->sq_ptr) {
+        munmap(ring->sq_ptr, ring->sq_len);
+    }
+    if (ring->ring_fd >= 0) {
+        close(ring->ring_fd);
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+}
+
+int uring_register_buffers(Uring* ring, const struct iovec* iovecs, unsigned count) {
+    return sys_io_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS, iovecs, count);
+}
+
+struct io_uring_sqe* uring_get_sqe(Uring* ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->entries) {
+        return NULL;
+    }
+
+    unsigned index = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+/*
+ * Publishes every prepared SQE with a single io_uring_enter and waits for
+ * wait_nr completions. SQEs the kernel has not consumed yet, including those
+ * a short submit left behind, are offered again. Returns how many it took.
+ */
+int uring_submit(Uring* ring, unsigned wait_nr) {
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    int result;
+    do {
+        unsigned to_submit = ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (to_submit == 0 && wait_nr == 0) {
+            return 0;
+        }
+        result = sys_io_uring_enter(ring->ring_fd, to_submit, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+    } while (result < 0 && errno == EINTR);
+    return result;
+}
+
+/* Takes back the newest SQE the kernel has not consumed; false once none is left. */
+bool uring_unprepare(Uring* ring, __u64* user_data) {
+    if (ring->sq_local_tail == __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    ring->sq_local_tail--;
+    *user_data = ring->sqes[ring->sq_local_tail & *ring->sq_mask].user_data;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    return true;
+}
+
+struct io_uring_cqe* uring_peek_cqe(Uring* ring) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return NULL;
+    }
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+void uring_cqe_seen(Uring* ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/* What was submitted from a buffer slot, to judge its completion. */
+typedef struct {
+    struct timespec submitted_at;
+    size_t position;
+    bool is_write;
+} UringSlot;
+
+/* Buffer slots move from free to prepared (in the SQ ring) to inflight (taken by the kernel) and back. */
+typedef struct {
+    unsigned* free_slots;
+    unsigned free_count;
+    unsigned prepared;
+    unsigned inflight;
+} UringQueue;
+
+/*
+ * Submits the prepared SQEs. When the kernel is only short of resources they
+ * stay prepared until completions free some; on any other failure they are
+ * taken back, so nothing is waited for that was never submitted.
+ */
+static int submit_prepared(Uring* ring, UringQueue* queue, unsigned wait_nr) {
+    int result = uring_submit(ring, wait_nr);
+    if (result > 0 || (result == 0 && queue->prepared == 0)) {
+        queue->prepared -= (unsigned)result;
+        queue->inflight += (unsigned)result;
+        return 0;
+    }
+    if (result == 0) {
+        errno = EAGAIN;
+    }
+    if ((errno == EAGAIN || errno == EBUSY) && queue->inflight > 0) {
+        return 0;
+    }
+    perror("Error submitting to io_uring");
+    __u64 user_data;
+    while (uring_unprepare(ring, &user_data)) {
+        queue->free_slots[queue->free_count++] = (unsigned)user_data;
+        queue->prepared--;
+    }
+    return -1;
+}
+
+size_t run_io_uring(Worker* worker) {
+    const Workload* workload = &worker->workload;
+    const LoaderOptions* options = worker->options;
+    int fd = worker->io_mode == IO_DIRECT ? worker->fd : fileno(worker->file);
+    unsigned depth = options->queue_depth;
+    size_t blocks_processed = 0;
+    Uring ring;
+
+    if (uring_init(&ring, depth) != 0) {
+        perror("Error setting up io_uring");
+        return 0;
+    }
+    if (depth > ring.entries) {
+        depth = ring.entries;
+    }
+
+    char* buffers = NULL;
+    int result = posix_memalign((void**)&buffers, ALIGNMENT, depth * workload->block_size);
+    struct iovec* iovecs = calloc(depth, sizeof(struct iovec));
+    UringQueue queue = {calloc(depth, sizeof(unsigned)), depth, 0, 0};
+    UringSlot* slots = calloc(depth, sizeof(UringSlot));
+    if (result != 0 || !iovecs || !queue.free_slots || !slots) {
+        printf("Memory allocation failed for io_uring buffers\n");
+        free(buffers);
+        free(iovecs);
+        free(queue.free_slots);
+        free(slots);
+        uring_destroy(&ring);
+        return 0;
+    }
+
+    for (unsigned i = 0; i < depth; i++) {
+        iovecs[i].iov_base = buffers + (size_t)i * workload->block_size;
+        iovecs[i].iov_len = workload->block_size;
+        queue.free_slots[i] = depth - 1 - i;
+    }
+
+    bool fixed = uring_register_buffers(&ring, iovecs, depth) == 0;
+    if (!fixed) {
+        perror("Registering fixed buffers failed, using plain read/write ops");
+    }
+
+    size_t issued = 0;
+    bool stop = false;
+    bool wait_failed = false;
+
+    while (true) {
+        while (!stop && queue.free_count > 0 && issued < workload->block_count) {
+            size_t position;
+            if (next_position(workload, issued, &worker->rng, &position) != 0) {
+                stop = true;
+                break;
+            }
+
+            struct io_uring_sqe* sqe = uring_get_sqe(&ring);
+            if (sqe == NULL) {
+                break;
+            }
+
+            unsigned slot = queue.free_slots[--queue.free_count];
+            bool is_write = next_is_write(workload, &worker->rng);
+            if (is_write) {
+                memset(iovecs[slot].iov_base, 'A' + (issued % 26), workload->block_size);
+            }
+
+            if (fixed) {
+                sqe->opcode = is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                sqe->buf_index = (__u16)slot;
+            } else {
+                sqe->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+            }
+            sqe->fd = fd;
+            sqe->addr = (__u64)(uintptr_t)iovecs[slot].iov_base;
+            sqe->len = (__u32)workload->block_size;
+            sqe->off = (__u64)position;
+            sqe->user_data = slot;
+            slots[slot].position = position;
+            slots[slot].is_write = is_write;
+            clock_gettime(CLOCK_MONOTONIC, &slots[slot].submitted_at);
+
+            issued++;
+            if (++queue.prepared >= options->submit_batch && submit_prepared(&ring, &queue, 0) != 0) {
+                stop = true;
+            }
+        }
+
+        if (queue.prepared == 0 && queue.inflight == 0) {
+            break;
+        }
+
+        /*
+         * One completion is enough to refill its slot; waiting for more would
+         * let the queue drain. A second failure in a row gives up on the rest.
+         */
+        if (submit_prepared(&ring, &queue, 1) != 0) {
+            if (wait_failed) {
+                break;
+            }
+            wait_failed = true;
+            stop = true;
+        } else {
+            wait_failed = false;
+        }
+
+        struct timespec completed_at;
+        clock_gettime(CLOCK_MONOTONIC, &completed_at);
+
+        struct io_uring_cqe* cqe;
+        while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+            UringSlot* done = &slots[cqe->user_data];
+            if (cqe->res < 0) {
+                errno = -cqe->res;
+                perror("Error reading/writing file");
+                stop = true;
+            } else if ((size_t)cqe->res < workload->block_size) {
+                /* A short transfer is not a block; like the sync engines, it ends the run. */
+                if (!stop) {
+                    if (done->is_write) {
+                        printf("Short write of %d bytes at position %zu\n", cqe->res, done->position);
+                    } else {
+                        printf("End of file reached\n");
+                    }
+                }
+                stop = true;
+            } else {
+                record_op(worker, &done->submitted_at, &completed_at, 1);
+                blocks_processed++;
+            }
+            queue.free_slots[queue.free_count++] = (unsigned)cqe->user_data;
+            queue.inflight--;
+            uring_cqe_seen(&ring);
+        }
+    }
+
+    uring_destroy(&ring);
+    free(buffers);
+    free(iovecs);
+    free(queue.free_slots);
+    free(slots);
+    return blocks_processed;
+}
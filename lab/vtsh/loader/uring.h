@@ -0,0 +1,40 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+typedef struct {
+    int ring_fd;
+    unsigned entries;
+
+    void* sq_ptr;
+    size_t sq_len;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    size_t sqes_len;
+    unsigned sq_local_tail;
+
+    void* cq_ptr;
+    size_t cq_len;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+} Uring;
+
+int uring_init(Uring* ring, unsigned entries);
+void uring_destroy(Uring* ring);
+int uring_register_buffers(Uring* ring, const struct iovec* iovecs, unsigned count);
+struct io_uring_sqe* uring_get_sqe(Uring* ring);
+int uring_submit(Uring* ring, unsigned wait_nr);
+bool uring_unprepare(Uring* ring, __u64* user_data);
+struct io_uring_cqe* uring_peek_cqe(Uring* ring);
+void uring_cqe_seen(Uring* ring);
+
+#endif
@@ -18,9 +18,9 @@ class BaseShellTest(TestCase):
     def add_test_file(self, filename: str):
         self.test_files.add(filename)
 
-    def execute(self, cmd: str, expected: Optional[str] = None):
-        status, stdout = self.shell.execute(cmd)
+    def execute(self, cmd: str, expected: Optional[str] = None, *args: str, status: int = 0):
+        actual_status, stdout = self.shell.execute(cmd, *args)
 
-        self.assertEqual(status, 0)
+        self.assertEqual(actual_status, status)
         if expected is not None:
             self.assertEqual(stdout, expected)
@@ -5,9 +5,9 @@ class Shell:
     def __init__(self, path: str):
         self._path = path
 
-    def execute(self, cmd: str):
+    def execute(self, cmd: str, *args: str):
         shell = subprocess.Popen(
-            self._path,
+            [self._path, *args],
             stdin=subprocess.PIPE,
             stdout=subprocess.PIPE,
             stderr=subprocess.PIPE,
@@ -0,0 +1,42 @@
+from base_test import BaseShellTest
+
+NUMBER = r"\d+\.\d{3}"
+
+
+class TestShellBench(BaseShellTest):
+    def test_invalid_arguments(self):
+        self.execute("bench", "")
+        self.execute("bench -n 0 true", "")
+        self.execute("bench -n x true", "")
+        self.execute("bench -w -1 true", "")
+        self.execute("bench -j 0 true", "")
+        self.execute("bench -n 1 -w 0 nosuchcommand", "")
+
+    def test_output_shape(self):
+        status, stdout = self.shell.execute("bench -n 3 -w 1 true")
+
+        self.assertEqual(status, 0)
+        lines = stdout.splitlines()
+        self.assertEqual(len(lines), 4)
+        self.assertEqual(lines[0], "bench: 3 runs of true after 1 warmup, 1 copy at a time")
+        self.assertRegex(lines[1], rf"^  wall: min {NUMBER} ms, median {NUMBER} ms, mean {NUMBER} ms \+- {NUMBER} ms, "
+                                   rf"p95 {NUMBER} ms, max {NUMBER} ms$")
+        self.assertRegex(lines[2], rf"^  cpu: {NUMBER} ms user\+sys per run, \d+\.\d{{2}} CPUs busy$")
+        self.assertRegex(lines[3], r"^bench-summary command=true runs=3 warmup=1 jobs=1 min_ms=\S+ median_ms=\S+ "
+                                   r"mean_ms=\S+ stddev_ms=\S+ p95_ms=\S+ max_ms=\S+ cpu_ms=\S+ cpus=\S+ "
+                                   r"outliers=\d+ failed=0$")
+
+    def test_parallel_copies(self):
+        status, stdout = self.shell.execute("bench -n 2 -w 0 -j 2 -- echo hi")
+
+        self.assertEqual(status, 0)
+        lines = stdout.splitlines()
+        self.assertEqual(lines.count("hi"), 4)
+        self.assertIn("bench: 2 runs of echo after 0 warmup, 2 copies at a time", lines)
+        self.assertRegex(lines[-1], r"^bench-summary command=echo runs=2 warmup=0 jobs=2 .* failed=0$")
+
+    def test_failed_runs(self):
+        status, stdout = self.shell.execute("bench -n 2 -w 0 false")
+
+        self.assertEqual(status, 0)
+        self.assertRegex(stdout.splitlines()[-1], r"failed=2$")
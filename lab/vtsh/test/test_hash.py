@@ -0,0 +1,56 @@
+import os
+import shutil
+import tempfile
+
+from base_test import BaseShellTest
+
+
+class TestShellHash(BaseShellTest):
+    def setUp(self):
+        super().setUp()
+        self.directory = tempfile.mkdtemp()
+        self.first = os.path.join(self.directory, "first")
+        self.second = os.path.join(self.directory, "second")
+        os.mkdir(self.first)
+        os.mkdir(self.second)
+        self.path = os.environ["PATH"]
+        os.environ["PATH"] = f"{self.first}:{self.second}:{self.path}"
+
+    def tearDown(self):
+        os.environ["PATH"] = self.path
+        shutil.rmtree(self.directory)
+        super().tearDown()
+
+    def add_command(self, directory: str, output: str):
+        path = os.path.join(directory, "vtcmd")
+        with open(path, "w") as script:
+            script.write(f"#!/bin/sh\necho {output}\n")
+        os.chmod(path, 0o755)
+        return path
+
+    def test_empty_table(self):
+        self.execute("hash", "hash: hash table empty")
+
+    def test_remembers_commands(self):
+        path = self.add_command(self.second, "second")
+
+        self.execute("vtcmd\nvtcmd\nhash", f"second\nsecond\nhits\tcommand\n   2\t{path}")
+        self.execute("hash vtcmd\nhash", f"hits\tcommand\n   1\t{path}")
+        self.execute("hash nosuchcommand\nhash", "hash: hash table empty")
+
+    def test_forget(self):
+        self.add_command(self.second, "second")
+
+        self.execute("vtcmd\nhash -r\nhash", "second\nhash: hash table empty")
+
+    def test_rehash_finds_shadowing_command(self):
+        self.add_command(self.second, "second")
+        staged = self.add_command(self.directory, "first")
+
+        self.execute(f"vtcmd\ncp {staged} {self.first}/vtcmd\nvtcmd\nhash -r\nvtcmd", "second\nsecond\nfirst")
+
+    def test_missing_file_is_resolved_again(self):
+        self.add_command(self.first, "first")
+        self.add_command(self.second, "second")
+
+        self.execute(f"vtcmd\nrm {self.first}/vtcmd\nvtcmd\nvtcmd", "first\nsecond")
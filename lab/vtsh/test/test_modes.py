@@ -0,0 +1,35 @@
+from base_test import BaseShellTest
+
+
+class TestShellModes(BaseShellTest):
+    def test_command_string(self):
+        self.execute("", "one\ntwo", "-c", "echo one; echo two")
+        self.execute("", "a\nb", "-c", "echo a\necho b")
+
+    def test_command_string_status(self):
+        self.execute("", "", "-c", "false", status=1)
+        self.execute("", "yes", "-c", "false || echo yes")
+
+    def test_command_string_ignores_stdin(self):
+        self.execute("echo from stdin", "from argument", "-c", "echo from argument")
+
+    def test_script_file(self):
+        self.add_test_file("script.vtsh")
+        with open("script.vtsh", "w") as script:
+            script.write("echo s1\nfalse\necho s2 # comment\n")
+
+        self.execute("echo from stdin", "s1\ns2", "script.vtsh")
+
+    def test_script_file_status(self):
+        self.add_test_file("status.vtsh")
+        with open("status.vtsh", "w") as script:
+            script.write("echo s1\nfalse\n")
+
+        self.execute("", "s1", "status.vtsh", status=1)
+
+    def test_missing_script(self):
+        self.execute("", "", "no-such-script.vtsh", status=127)
+
+    def test_stdin_status(self):
+        self.execute("false", "")
+        self.execute("echo done\nfalse", "done")
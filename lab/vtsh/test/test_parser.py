@@ -0,0 +1,34 @@
+from base_test import BaseShellTest
+
+
+class TestShellParser(BaseShellTest):
+    def test_sequencing(self):
+        self.execute("echo a; echo b", "a\nb")
+        self.execute("echo a;echo b;", "a\nb")
+        self.execute("echo first ; ; echo second", "Syntax error near unexpected ';'")
+
+    def test_and_or(self):
+        self.execute("true && echo yes", "yes")
+        self.execute("false || echo fallback", "fallback")
+        self.execute("true || echo no", "")
+
+    def test_short_circuit_on_failure(self):
+        self.execute("false && echo no; echo yes", "yes")
+        self.execute("false && echo no || echo recovered", "recovered")
+        self.execute("cat /sys/proc/foo/bar && echo no", "")
+
+    def test_quoted_arguments_with_spaces(self):
+        self.execute('echo "hello   world"', "hello   world")
+        self.execute("echo 'a  b' c", "a  b c")
+        self.execute("echo one\\ \\ two", "one  two")
+        self.execute("echo 'a;b' \"c && d\"", "a;b c && d")
+
+    def test_comment_stripping(self):
+        self.execute("echo visible # hidden", "visible")
+        self.execute("# only a comment", "")
+        self.execute("echo a#b", "a#b")
+        self.execute("echo '# quoted'", "# quoted")
+
+    def test_syntax_errors(self):
+        self.execute("echo 'unterminated\necho after", "Syntax error: unterminated quote\nafter")
+        self.execute("&& echo bad", "Syntax error near unexpected '&&'")